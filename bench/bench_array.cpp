@@ -0,0 +1,129 @@
+/*
+ * Compares the kernels of the typed arrays with the plain loops liquid generates
+ * for the same operation (e.g. while i < len(a) ... s = s + a[i]).
+ *
+ * Usage: bench_array [max elements] (default 100000000)
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "buildins.h"
+
+namespace
+{
+volatile double sinkDouble;
+
+/*! Runs f repeat times and returns the best time in milliseconds. */
+double measure(const std::function<void()>& f, int repeat)
+{
+   double best = 1e30;
+   for (int r = 0; r < repeat; ++r) {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+   }
+   return best;
+}
+
+void report(const char* name, int64_t n, double plain, double kernel)
+{
+   printf("%-8s n=%-10lld plain %9.3f ms  kernel %9.3f ms  speedup %5.2fx\n", name, static_cast<long long>(n), plain, kernel, plain / kernel);
+}
+
+void run(int64_t n)
+{
+   auto x   = static_cast<double*>(liq_array_alloc(n, sizeof(double)));
+   auto y   = static_cast<double*>(liq_array_alloc(n, sizeof(double)));
+   auto out = static_cast<double*>(liq_array_alloc(n, sizeof(double)));
+   auto xi  = static_cast<int64_t*>(liq_array_alloc(n, sizeof(int64_t)));
+   for (int64_t i = 0; i < n; ++i) {
+      x[i]  = static_cast<double>(i % 1000) * 0.001;
+      y[i]  = 1.0 - x[i];
+      xi[i] = i % 1000;
+   }
+   int repeat = n >= 100000000 ? 3 : 10;
+
+   double plain = measure([&] {
+      double s = 0.;
+      for (int64_t i = 0; i < n; ++i) {
+         s += x[i];
+      }
+      sinkDouble = s;
+   }, repeat);
+   double kernel = measure([&] { sinkDouble = liq_sum_f64(x, n); }, repeat);
+   report("sum f64", n, plain, kernel);
+
+   plain = measure([&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += xi[i];
+      }
+      sinkDouble = static_cast<double>(s);
+   }, repeat);
+   kernel = measure([&] { sinkDouble = static_cast<double>(liq_sum_i64(xi, n)); }, repeat);
+   report("sum i64", n, plain, kernel);
+
+   plain = measure([&] {
+      double m = x[0];
+      for (int64_t i = 1; i < n; ++i) {
+         m = x[i] < m ? x[i] : m;
+      }
+      sinkDouble = m;
+   }, repeat);
+   kernel = measure([&] { sinkDouble = liq_min_f64(x, n); }, repeat);
+   report("min f64", n, plain, kernel);
+
+   plain = measure([&] {
+      double s = 0.;
+      for (int64_t i = 0; i < n; ++i) {
+         s += x[i] * y[i];
+      }
+      sinkDouble = s;
+   }, repeat);
+   kernel = measure([&] { sinkDouble = liq_dot_f64(x, y, n); }, repeat);
+   report("dot f64", n, plain, kernel);
+
+   plain = measure([&] {
+      for (int64_t i = 0; i < n; ++i) {
+         out[i] = 2.5 * x[i] + y[i];
+      }
+      sinkDouble = out[n - 1];
+   }, repeat);
+   kernel = measure([&] {
+      liq_axpy_f64(out, 2.5, x, y, n);
+      sinkDouble = out[n - 1];
+   }, repeat);
+   report("axpy f64", n, plain, kernel);
+
+   plain = measure([&] {
+      for (int64_t i = 0; i < n; ++i) {
+         out[i] = x[i] * y[i];
+      }
+      sinkDouble = out[n - 1];
+   }, repeat);
+   kernel = measure([&] {
+      liq_mul_f64(out, x, y, n);
+      sinkDouble = out[n - 1];
+   }, repeat);
+   report("mul f64", n, plain, kernel);
+
+   liq_array_free(x);
+   liq_array_free(y);
+   liq_array_free(out);
+   liq_array_free(xi);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+   int64_t maxElements = argc > 1 ? std::stoll(argv[1]) : 100000000;
+   for (int64_t n = 1000000; n <= maxElements; n *= 10) {
+      run(n);
+   }
+   return 0;
+}
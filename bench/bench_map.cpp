@@ -0,0 +1,206 @@
+/*
+ * Compares the hash map of the runtime (map<K,V>) with std::unordered_map for
+ * inserting, finding present and missing keys and removing all keys.
+ * The keys are looked up in a different order than they were inserted, otherwise the nodes of
+ * std::unordered_map are visited in the order they were allocated.
+ *
+ * Usage: bench_map [max keys] (default 10000000)
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buildins.h"
+
+namespace
+{
+volatile int64_t sinkInteger;
+
+/*! Runs f repeat times and returns the best time in milliseconds. The setup isn't measured. */
+double measure(const std::function<void()>& setup, const std::function<void()>& f, int repeat)
+{
+   double best = 1e30;
+   for (int r = 0; r < repeat; ++r) {
+      setup();
+      auto start = std::chrono::steady_clock::now();
+      f();
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+   }
+   return best;
+}
+
+void report(const char* name, int64_t n, double stl, double liq)
+{
+   printf("%-12s n=%-10lld unordered_map %9.3f ms  map %9.3f ms  speedup %5.2fx\n", name, static_cast<long long>(n), stl, liq, stl / liq);
+}
+
+/*! Scrambles the keys, so they don't hit the slots in order. */
+int64_t keyOf(int64_t i) { return static_cast<int64_t>(static_cast<uint64_t>(i) * 0x9e3779b97f4a7c15ull); }
+
+/*! Returns the numbers 0 to n - 1 shuffled. */
+std::vector<int64_t> shuffled(int64_t n)
+{
+   std::vector<int64_t> order(n);
+   std::iota(order.begin(), order.end(), 0);
+   std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+   return order;
+}
+
+void runInteger(int64_t n)
+{
+   int  repeat = n >= 10000000 ? 3 : 5;
+   auto order  = shuffled(n);
+   std::unordered_map<int64_t, int64_t> stl;
+   void*                                liq = nullptr;
+   auto resetStl = [&] { stl = std::unordered_map<int64_t, int64_t>(); };
+   auto resetLiq = [&] {
+      if (liq != nullptr) {
+         liq_map_free_i64(liq);
+      }
+      liq = liq_map_new_i64();
+   };
+   auto fillStl = [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         stl[keyOf(i)] = i;
+      }
+   };
+   auto fillLiq = [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         liq_map_put_i64(liq, keyOf(i), i);
+      }
+   };
+   auto refillStl = [&] {
+      resetStl();
+      fillStl();
+   };
+   auto refillLiq = [&] {
+      resetLiq();
+      fillLiq();
+   };
+   auto none = [] {};
+
+   double tStl = measure(resetStl, fillStl, repeat);
+   double tLiq = measure(resetLiq, fillLiq, repeat);
+   report("put i64", n, tStl, tLiq);
+
+   tStl = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += stl.find(keyOf(order[i]))->second;
+      }
+      sinkInteger = s;
+   }, repeat);
+   tLiq = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += liq_map_get_i64(liq, keyOf(order[i]), 0);
+      }
+      sinkInteger = s;
+   }, repeat);
+   report("get i64 hit", n, tStl, tLiq);
+
+   tStl = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += stl.count(keyOf(n + order[i]));
+      }
+      sinkInteger = s;
+   }, repeat);
+   tLiq = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += liq_map_contains_i64(liq, keyOf(n + order[i]));
+      }
+      sinkInteger = s;
+   }, repeat);
+   report("get i64 miss", n, tStl, tLiq);
+
+   tStl = measure(refillStl, [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         stl.erase(keyOf(order[i]));
+      }
+   }, repeat);
+   tLiq = measure(refillLiq, [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         liq_map_remove_i64(liq, keyOf(order[i]));
+      }
+   }, repeat);
+   report("remove i64", n, tStl, tLiq);
+
+   liq_map_free_i64(liq);
+}
+
+void runString(int64_t n)
+{
+   int  repeat = n >= 10000000 ? 3 : 5;
+   auto order  = shuffled(n);
+   // The same keys for both, as std::string and as string of the runtime.
+   std::vector<std::string> keys;
+   std::vector<char*>       strings;
+   for (int64_t i = 0; i < n; ++i) {
+      keys.push_back("key" + std::to_string(keyOf(i)));
+      auto str = liq_str_alloc(static_cast<int64_t>(keys.back().size()));
+      std::memcpy(str, keys.back().data(), keys.back().size());
+      strings.push_back(str);
+   }
+   std::unordered_map<std::string, int64_t> stl;
+   void*                                    liq = nullptr;
+   auto resetStl = [&] { stl = std::unordered_map<std::string, int64_t>(); };
+   auto resetLiq = [&] {
+      if (liq != nullptr) {
+         liq_map_free_str(liq);
+      }
+      liq = liq_map_new_str();
+   };
+   auto none = [] {};
+
+   double tStl = measure(resetStl, [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         stl[keys[i]] = i;
+      }
+   }, repeat);
+   double tLiq = measure(resetLiq, [&] {
+      for (int64_t i = 0; i < n; ++i) {
+         liq_map_put_str(liq, strings[i], i);
+      }
+   }, repeat);
+   report("put str", n, tStl, tLiq);
+
+   tStl = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += stl.find(keys[order[i]])->second;
+      }
+      sinkInteger = s;
+   }, repeat);
+   tLiq = measure(none, [&] {
+      int64_t s = 0;
+      for (int64_t i = 0; i < n; ++i) {
+         s += liq_map_get_str(liq, strings[order[i]], 0);
+      }
+      sinkInteger = s;
+   }, repeat);
+   report("get str hit", n, tStl, tLiq);
+
+   liq_map_free_str(liq);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+   int64_t maxKeys = argc > 1 ? std::stoll(argv[1]) : 10000000;
+   for (int64_t n = 100000; n <= maxKeys; n *= 10) {
+      runInteger(n);
+      runString(n);
+   }
+   return 0;
+}
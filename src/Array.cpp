@@ -3,6 +3,7 @@
 #include "CodeGenContext.h"
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/ADT/ArrayRef.h>
+#include <algorithm>
 
 using namespace llvm;
 
@@ -14,15 +15,42 @@ llvm::Value* Array::codeGen(CodeGenContext& context)
    using TypeList = std::vector<Type*>;
    ValueList values;
    TypeList types;
+   std::vector<std::string> liquidTypes;
    for( auto e : *exprList ) {
       auto code = e->codeGen(context);
+      auto nested = dyn_cast_or_null<AllocaInst>(code);
+      if( nested != nullptr && nested->getAllocatedType()->isStructTy() ) {
+         // A list in a list is stored by value, the pointer would lose the type of the nested list.
+         code = new LoadInst(nested->getAllocatedType(), nested, "nested_list", context.currentBlock());
+      }
       if( code != nullptr ) {
          values.push_back(code);
          types.push_back(code->getType());
+         liquidTypes.push_back(context.getLiquidType(code));
       }
    }
-   auto str = llvm::StructType::create(context.getGlobalContext(), types, "list");
+   // Literal struct types are uniqued, lists with the same element types share one type.
+   auto str = llvm::StructType::get(context.getGlobalContext(), types);
    auto alloc_str = new AllocaInst(str, 0, "alloc_list",context.currentBlock());
+   // A string and an object are both a ptr element, the list keeps which one it is.
+   context.setListElementTypes(alloc_str, std::move(liquidTypes));
+   bool allConstant = !values.empty() && std::all_of(values.begin(), values.end(), [](Value* v) { return isa<Constant>(v); });
+   if( allConstant ) {
+      // The elements are put into a read only global and copied as a whole. Since a list is never written
+      // the optimizer replaces the copy by the global itself, so the copy only happens if needed.
+      std::vector<Constant*> constants;
+      for( auto v : values ) {
+         constants.push_back(cast<Constant>(v));
+      }
+      auto module = context.getModule();
+      auto table = new GlobalVariable(*module, str, true, GlobalValue::PrivateLinkage, ConstantStruct::get(str, constants), ".list");
+      table->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+      auto align = module->getDataLayout().getPrefTypeAlign(str);
+      table->setAlignment(align);
+      IRBuilder<> builder(context.currentBlock());
+      builder.CreateMemCpy(alloc_str, alloc_str->getAlign(), table, align, module->getDataLayout().getTypeAllocSize(str));
+      return alloc_str;
+   }
    std::vector<Value*> ptr_indices;
    ConstantInt* const_int32_0 = ConstantInt::get(context.getModule()->getContext(), APInt(32, 0));
    for( size_t index = 0u; index < values.size(); ++index ) {
@@ -38,36 +66,70 @@ llvm::Value* Array::codeGen(CodeGenContext& context)
 
 llvm::Value* ArrayAccess::codeGen(CodeGenContext& context)
 {
+   std::string name = variable != nullptr ? variable->getName() : "list";
    AllocaInst* var = nullptr;
+   Value* value = nullptr;
    Type* var_struct_type = nullptr;
-   if( other != nullptr ) {
-      auto tmp = other->codeGen(context);
-      var = new AllocaInst(tmp->getType(), 0, "tmp_alloc_list_other", context.currentBlock());
-      new StoreInst(tmp, var, context.currentBlock());
-      var_struct_type = var->getAllocatedType()->getContainedType(0);
+   Expression* inner = other;
+   if( inner == nullptr && variable != nullptr && !variable->getStructName().empty() ) {
+      // An instance variable or the column of a struct of arrays like p.x[i].
+      inner = variable;
+   }
+   if( inner != nullptr ) {
+      // Nested access like l[0][1], the inner access yields the value of the element.
+      value = inner->codeGen(context);
+      if( value == nullptr ) {
+         return nullptr;
+      }
+      var_struct_type = value->getType();
    } else {
       var = context.findVariable(variable->getName());
       if( var == nullptr ) {
          Node::printError(location, "unknown variable " + variable->getName());
+         context.addError();
          return nullptr;
       }
       var_struct_type = var->getAllocatedType();
    }
-   if( var_struct_type == nullptr ) {
-      Node::printError(location, "Type mismatch: variable " + variable->getName() + " must have type list but has type " + context.getType(variable->getName()));
-      context.addError();
-      return nullptr;
+   if( context.isArrayType(var_struct_type) ) {
+      if( var != nullptr ) {
+         value = new LoadInst(var_struct_type, var, name, context.currentBlock());
+      }
+      return codeGenArrayElement(value, context);
+   }
+   if( context.isMapType(var_struct_type) ) {
+      if( var != nullptr ) {
+         value = new LoadInst(var_struct_type, var, name, context.currentBlock());
+      }
+      return codeGenMapElement(value, context);
+   }
+   if( context.isSoaType(var_struct_type) ) {
+      if( var != nullptr ) {
+         value = new LoadInst(var_struct_type, var, name, context.currentBlock());
+      }
+      return codeGenSoaRecord(value, context);
    }
    if( var_struct_type->getTypeID() != StructType::StructTyID ) {
-      Node::printError(location, "Type mismatch: variable " + variable->getName() + " must have type list but has type " + context.getType(variable->getName()));
+      Node::printError(location, "Type mismatch: variable " + name + " must have type list but has type " + context.getType(name));
       context.addError();
       return nullptr;
    }
-   if( var_struct_type->getNumContainedTypes() <= index ) {
-      Node::printError(location, variable->getName() + " : index out of range (with index(zero based) = " + std::to_string(index) + " and size = " + std::to_string(var_struct_type->getNumContainedTypes()) + ")");
+   if( indexExpr != nullptr ) {
+      if( indexExpr->getType() != NodeType::integer ) {
+         Node::printError(location, name + " : the index of a list must be a constant integer.");
+         context.addError();
+         return nullptr;
+      }
+      index = static_cast<Integer*>(indexExpr)->getValue();
+   }
+   if( index < 0 || var_struct_type->getNumContainedTypes() <= index ) {
+      Node::printError(location, name + " : index out of range (with index(zero based) = " + std::to_string(index) + " and size = " + std::to_string(var_struct_type->getNumContainedTypes()) + ")");
       context.addError();
       return nullptr;
    }
+   if( var == nullptr ) {
+      return ExtractValueInst::Create(value, {static_cast<unsigned>(index)}, "get_struct_element", context.currentBlock());
+   }
    std::vector<Value*> ptr_indices;
    ConstantInt* const_int32_0 = ConstantInt::get(context.getModule()->getContext(), APInt(32, 0));
    ConstantInt* const_int32 = ConstantInt::get(context.getModule()->getContext(), APInt(32, index));
@@ -75,13 +137,168 @@ llvm::Value* ArrayAccess::codeGen(CodeGenContext& context)
    ptr_indices.push_back(const_int32);
    Instruction* ptr = GetElementPtrInst::Create( var_struct_type, /*val*/ var, ptr_indices, "get_struct_element", context.currentBlock());
    auto valueType = var_struct_type->getContainedType(index);
-   context.currentBlock()->dump();
-   auto value = new LoadInst(valueType, ptr, "load_ptr_struct", context.currentBlock());
-   return value;
+   auto loaded = new LoadInst(valueType, ptr, "load_ptr_struct", context.currentBlock());
+   context.setLiquidType(loaded, context.getListElementType(var, static_cast<unsigned>(index)));
+   return loaded;
+}
+
+llvm::Value* ArrayAccess::codeGenStore(llvm::Value* value, CodeGenContext& context)
+{
+   std::string name      = variable != nullptr ? variable->getName() : "list";
+   Value*      container = nullptr;
+   Expression* inner     = other;
+   if( inner == nullptr && variable != nullptr && !variable->getStructName().empty() ) {
+      inner = variable;
+   }
+   if( inner != nullptr ) {
+      container = inner->codeGen(context);
+      if( container == nullptr ) {
+         return nullptr;
+      }
+   } else {
+      auto var = context.findVariable(name);
+      if( var == nullptr ) {
+         Node::printError(location, "unknown variable " + name);
+         context.addError();
+         return nullptr;
+      }
+      auto type = var->getAllocatedType();
+      if( context.isArrayType(type) || context.isMapType(type) ) {
+         container = new LoadInst(type, var, name, context.currentBlock());
+      }
+   }
+   if( container != nullptr && context.isArrayType(container->getType()) ) {
+      auto elementType = context.getArrayElementType(container->getType());
+      if( value->getType() == context.getGenericIntegerType() && elementType->isDoubleTy() ) {
+         value = CastInst::Create(Instruction::SIToFP, value, elementType, "castdb", context.currentBlock());
+      }
+      if( value->getType() != elementType ) {
+         Node::printError(location, "The value doesn't match the element type of " + context.typeNameOf(container->getType()) + ".");
+         context.addError();
+         return nullptr;
+      }
+      auto indexValue = codeGenIndex(context);
+      if( indexValue == nullptr ) {
+         return nullptr;
+      }
+      // Like the element access there is no bounds check.
+      auto data = ExtractValueInst::Create(container, {0}, "data", context.currentBlock());
+      auto ptr  = GetElementPtrInst::CreateInBounds(elementType, data, {indexValue}, "set_array_element", context.currentBlock());
+      return new StoreInst(value, ptr, false, context.currentBlock());
+   }
+   if( container != nullptr && context.isMapType(container->getType()) ) {
+      auto mapValue = context.convertMapItem(value, context.getMapValueType(container->getType()));
+      if( mapValue == nullptr ) {
+         Node::printError(location, "The value doesn't match the value type of " + context.typeNameOf(container->getType()) + ".");
+         context.addError();
+         return nullptr;
+      }
+      auto mapKey = codeGenMapKey(container, context);
+      if( mapKey == nullptr ) {
+         return nullptr;
+      }
+      return context.callMapBuiltin("put", container, mapKey, mapValue);
+   }
+   Node::printError(location, "Only an element of a typed array or a map can be assigned, " + name + " is neither.");
+   context.addError();
+   return nullptr;
+}
+
+llvm::Value* ArrayAccess::codeGenIndex(CodeGenContext& context)
+{
+   Value* indexValue = nullptr;
+   if( indexExpr != nullptr ) {
+      indexValue = indexExpr->codeGen(context);
+      if( indexValue == nullptr ) {
+         return nullptr;
+      }
+   } else {
+      indexValue = ConstantInt::get(context.getGenericIntegerType(), index);
+   }
+   if( !indexValue->getType()->isIntegerTy() ) {
+      Node::printError(location, "The index of an array must be an integer.");
+      context.addError();
+      return nullptr;
+   }
+   return indexValue;
+}
+
+llvm::Value* ArrayAccess::codeGenMapKey(llvm::Value* map, CodeGenContext& context)
+{
+   Value* key = nullptr;
+   if( indexExpr != nullptr ) {
+      key = indexExpr->codeGen(context);
+      if( key == nullptr ) {
+         return nullptr;
+      }
+   } else {
+      key = ConstantInt::get(context.getGenericIntegerType(), index);
+   }
+   auto mapKey = context.convertMapItem(key, context.getMapKeyType(map->getType()));
+   if( mapKey == nullptr ) {
+      Node::printError(location, "The key doesn't match the key type of " + context.typeNameOf(map->getType()) + ".");
+      context.addError();
+      return nullptr;
+   }
+   return mapKey;
+}
+
+llvm::Value* ArrayAccess::codeGenArrayElement(llvm::Value* array, CodeGenContext& context)
+{
+   auto indexValue = codeGenIndex(context);
+   if( indexValue == nullptr ) {
+      return nullptr;
+   }
+   // There is no bounds check, the element access has to stay as cheap as in C.
+   auto elementType = context.getArrayElementType(array->getType());
+   auto data = ExtractValueInst::Create(array, {0}, "data", context.currentBlock());
+   auto ptr = GetElementPtrInst::CreateInBounds(elementType, data, {indexValue}, "get_array_element", context.currentBlock());
+   return new LoadInst(elementType, ptr, "load_array_element", context.currentBlock());
+}
+
+llvm::Value* ArrayAccess::codeGenMapElement(llvm::Value* map, CodeGenContext& context)
+{
+   auto mapKey = codeGenMapKey(map, context);
+   if( mapKey == nullptr ) {
+      return nullptr;
+   }
+   // Like get(m, key), a missing key yields the zero value.
+   return context.callMapBuiltin("get", map, mapKey);
+}
+
+llvm::Value* ArrayAccess::codeGenSoaRecord(llvm::Value* soa, CodeGenContext& context)
+{
+   Value* indexValue = indexExpr != nullptr ? indexExpr->codeGen(context) : ConstantInt::get(context.getGenericIntegerType(), index);
+   if( indexValue == nullptr ) {
+      return nullptr;
+   }
+   if( !indexValue->getType()->isIntegerTy() ) {
+      Node::printError(location, "The index of a struct of arrays must be an integer.");
+      context.addError();
+      return nullptr;
+   }
+   // The record is copied into a new object, like an element of a typed array there is no bounds check.
+   return context.soaRecord(soa, indexValue);
+}
+
+llvm::Value* ArrayElementAssignment::codeGen(CodeGenContext& context)
+{
+   Value* value = expr->codeGen(context);
+   if( value == nullptr ) {
+      Node::printError(location, " Assignment expression results in nothing");
+      context.addError();
+      return nullptr;
+   }
+   return element->codeGenStore(value, context);
 }
 
 llvm::Value* ArrayAddElement::codeGen(CodeGenContext& context)
 {
+   auto soaVar = context.findVariable(ident->getName());
+   if( soaVar != nullptr && context.isSoaType(soaVar->getAllocatedType()) ) {
+      auto soa = new LoadInst(soaVar->getAllocatedType(), soaVar, ident->getName(), context.currentBlock());
+      return codeGenSoaAppend(soa, context);
+   }
    YYLTYPE loc = { 0,0,0,0 };
    Block tmp_code;
    ExpressionList members;
@@ -94,6 +311,12 @@ llvm::Value* ArrayAddElement::codeGen(CodeGenContext& context)
       return nullptr;
    }
    auto var_struct_type = var->getAllocatedType();
+   if( context.isArrayType(var_struct_type) ) {
+      context.renameVariable(tmpVarName, ident->getName());
+      Node::printError(location, "Can't add an element to the typed array " + ident->getName() + ".");
+      context.addError();
+      return nullptr;
+   }
    auto count = var_struct_type->getNumContainedTypes();
    Identifier tmpIdent(tmpVarName, loc);
    for( decltype(count) i = 0; i < count; ++i ) {
@@ -110,4 +333,85 @@ llvm::Value* ArrayAddElement::codeGen(CodeGenContext& context)
    return value;
 }
 
+llvm::Value* ArrayAddElement::codeGenSoaAppend(llvm::Value* soa, CodeGenContext& context)
+{
+   auto soaType = soa->getType();
+   auto object  = expr->codeGen(context);
+   if( object == nullptr ) {
+      return nullptr;
+   }
+   if( context.getObjectClassName(object) != context.getSoaClassName(soaType) ) {
+      Node::printError(location, "Only an object of class " + context.getSoaClassName(soaType) + " can be added to " + ident->getName() + ".");
+      context.addError();
+      return nullptr;
+   }
+   return context.soaAppend(soa, object);
+}
+
+llvm::Value* ArraySlice::codeGen(CodeGenContext& context)
+{
+   Value* array = nullptr;
+   auto   var   = context.findVariable(ident->getName());
+   if( !ident->getStructName().empty() ) {
+      // An instance variable or the column of a struct of arrays like p.x[1:].
+      array = ident->codeGen(context);
+      if( array != nullptr && !context.isArrayType(array->getType()) ) {
+         array = nullptr;
+      }
+   } else if( var == nullptr ) {
+      Node::printError(location, "unknown variable " + ident->getName());
+      context.addError();
+      return nullptr;
+   } else {
+      array = context.arrayViewOf(var);
+   }
+   if( array == nullptr && var != nullptr && context.isArrayType(var->getAllocatedType()) ) {
+      array = new LoadInst(var->getAllocatedType(), var, ident->getName(), context.currentBlock());
+   }
+   if( array == nullptr ) {
+      Node::printError(location, "Only a typed array or a list of numbers of the same type can be sliced.");
+      context.addError();
+      return nullptr;
+   }
+
+   auto block   = context.currentBlock();
+   auto intType = context.getGenericIntegerType();
+   auto data    = ExtractValueInst::Create(array, {0}, "data", block);
+   auto len     = ExtractValueInst::Create(array, {1}, "len", block);
+   auto bound   = [&](Expression* expr, Value* defaultValue) -> Value* {
+      if( expr == nullptr ) {
+         return defaultValue;
+      }
+      auto value = expr->codeGen(context);
+      if( value != nullptr && !value->getType()->isIntegerTy() ) {
+         Node::printError(location, "The bounds of a slice must be integers.");
+         context.addError();
+         return nullptr;
+      }
+      if( value != nullptr && value->getType() != intType ) {
+         value = CastInst::CreateIntegerCast(value, intType, true, "cast", block);
+      }
+      return value;
+   };
+   // clamp(value, low, high)
+   auto clamp = [&](Value* value, Value* low, Value* high) -> Value* {
+      auto isLess = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_SLT, value, low, "", block);
+      value       = SelectInst::Create(isLess, low, value, "", block);
+      auto isMore = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_SGT, value, high, "", block);
+      return SelectInst::Create(isMore, high, value, "", block);
+   };
+   auto first = bound(begin, ConstantInt::get(intType, 0));
+   auto last  = bound(end, len);
+   if( first == nullptr || last == nullptr ) {
+      return nullptr;
+   }
+   first = clamp(first, ConstantInt::get(intType, 0), len);
+   last  = clamp(last, first, len);
+
+   auto elementType = context.getArrayElementType(array->getType());
+   auto sliceData   = GetElementPtrInst::CreateInBounds(elementType, data, {first}, "slice", block);
+   auto sliceLen    = BinaryOperator::Create(Instruction::Sub, last, first, "slice_len", block);
+   return context.createArrayValue(array->getType(), sliceData, sliceLen);
+}
+
 }
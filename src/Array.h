@@ -25,12 +25,18 @@ private:
    YYLTYPE         location {};
 };
 
-/*! Represents an array element access */
+/*! Represents an array element access.
+ * A list (struct) needs a constant index, a typed array (int[], double[]) can be indexed by any integer expression.
+ * A map is indexed by a key, like get(m, key).
+ * A struct of arrays yields a copy of the record at the index as new object.
+ */
 class ArrayAccess : public Expression
 {
 public:
    ArrayAccess(Identifier* id, long long index, YYLTYPE loc) : variable(id), index(index), location(loc) {}
    ArrayAccess(Expression* id, long long index, YYLTYPE loc) : index(index), location(loc), other(id) {}
+   ArrayAccess(Identifier* id, Expression* index, YYLTYPE loc) : variable(id), location(loc), indexExpr(index) {}
+   ArrayAccess(Expression* id, Expression* index, YYLTYPE loc) : location(loc), other(id), indexExpr(index) {}
    virtual ~ArrayAccess() = default;
 
    llvm::Value* codeGen(CodeGenContext& context) override;
@@ -40,16 +46,56 @@ public:
 
    YYLTYPE getLocation() const { return location; }
 
+   /*! Stores the value into the element of a typed array or puts it into a map, like put(m, key, value). */
+   llvm::Value* codeGenStore(llvm::Value* value, CodeGenContext& context);
+
 private:
    Identifier* variable{nullptr};
    long long   index{0LL};
    YYLTYPE     location{};
    Expression* other{nullptr};
+   Expression* indexExpr{nullptr}; ///< The index expression, if not set index is used.
+
+   llvm::Value* codeGenIndex(CodeGenContext& context);
+   llvm::Value* codeGenMapKey(llvm::Value* map, CodeGenContext& context);
+   llvm::Value* codeGenArrayElement(llvm::Value* array, CodeGenContext& context);
+   llvm::Value* codeGenMapElement(llvm::Value* map, CodeGenContext& context);
+   llvm::Value* codeGenSoaRecord(llvm::Value* soa, CodeGenContext& context);
+
    friend class VisitorSyntaxCheck;
    friend class VisitorPrettyPrint;
+   friend class VisitorAssignedVariables;
 };
 
-/*! Represents adding an element to the array. */
+/*! Represents the assignment of an element, a[i] = value or m[key] = value.
+ * Only the elements of a typed array and the items of a map can be assigned, a list is never written.
+ */
+class ArrayElementAssignment : public Statement
+{
+public:
+   ArrayElementAssignment(ArrayAccess* element, Expression* expr, YYLTYPE loc) : element(element), expr(expr), location(loc) {}
+   virtual ~ArrayElementAssignment()
+   {
+      delete element;
+      delete expr;
+   }
+
+   llvm::Value* codeGen(CodeGenContext& context) override;
+   NodeType     getType() override { return NodeType::expression; }
+   std::string  toString() override { return "array element assignment"; }
+   void         Accept(Visitor& v) override { v.VisitArrayElementAssignment(this); }
+
+   YYLTYPE      getLocation() const { return location; }
+   ArrayAccess* getElement() const { return element; }
+   Expression*  getExpression() const { return expr; }
+
+private:
+   ArrayAccess* element{nullptr};
+   Expression*  expr{nullptr};
+   YYLTYPE      location;
+};
+
+/*! Represents adding an element to the array or an object to a struct of arrays. */
 class ArrayAddElement : public Statement
 {
 public:
@@ -68,8 +114,44 @@ private:
    Expression* expr{nullptr};
    Identifier* ident{nullptr};
    YYLTYPE     location;
+
+   llvm::Value* codeGenSoaAppend(llvm::Value* soa, CodeGenContext& context);
+
+   friend class VisitorSyntaxCheck;
+   friend class VisitorPrettyPrint;
+   friend class VisitorAssignedVariables;
+};
+
+/*! Represents a slice l[begin:end] of a typed array or a list of numbers.
+ * The result is a view into the existing elements (typed array value), nothing is copied.
+ * The bounds are clamped to the size, a missing begin is 0 and a missing end the size.
+ */
+class ArraySlice : public Expression
+{
+public:
+   ArraySlice(Identifier* ident, Expression* begin, Expression* end, YYLTYPE loc) : ident(ident), begin(begin), end(end), location(loc) {}
+   virtual ~ArraySlice()
+   {
+      delete ident;
+      delete begin;
+      delete end;
+   }
+
+   llvm::Value* codeGen(CodeGenContext& context) override;
+   NodeType     getType() override { return NodeType::list; }
+   std::string  toString() override { return "array slice"; }
+   void         Accept(Visitor& v) override { v.VisitArraySlice(this); }
+
+   YYLTYPE getLocation() const { return location; }
+
+private:
+   Identifier* ident{nullptr};
+   Expression* begin{nullptr};
+   Expression* end{nullptr};
+   YYLTYPE     location;
    friend class VisitorSyntaxCheck;
    friend class VisitorPrettyPrint;
+   friend class VisitorAssignedVariables;
 };
 
 } // namespace liquid
@@ -36,7 +36,12 @@ Value* Assignment::codeGen(CodeGenContext& context)
          if(context.locals()[lhs->getName()] == nullptr) {
             context.locals()[lhs->getName()] = var;
          }
+         // The variable gets the type of its first value, e.g. a string or the class of an object.
+         context.setLiquidType(var, context.getLiquidType(value));
          auto className                   = context.findClassNameByType(ty);
+         if (className.empty()) {
+            className = context.getObjectClassName(value);
+         }
          if (!className.empty()) {
             context.setVarType(className, lhs->getName());
          }
@@ -44,28 +49,56 @@ Value* Assignment::codeGen(CodeGenContext& context)
    } else {
       AllocaInst* varStruct = context.findVariable(lhs->getStructName());
       if (varStruct == nullptr) {
-         // Check if the assignment is coming from a class member initialization.
-         // In that case the context varStruct is set, which points to the member variable.
-         if (context.varStruct == nullptr) {
-            Node::printError(location, "undeclared variable '" + lhs->getName() + "'");
-            context.addError();
-            return nullptr;
-         }
-         varStruct = dyn_cast<AllocaInst>(context.varStruct);
-         if (varStruct == nullptr) {
-            Node::printError(location, "undeclared class of variable '" + lhs->getStructName() + "." + lhs->getName() + "'");
-            context.addError();
-            return nullptr;
-         }
-         std::string  klassName = lhs->getStructName();
-         Instruction* ptr       = context.getKlassVarAccessInst(klassName, lhs->getName(), varStruct);
-         return new StoreInst(value, ptr, false, context.currentBlock());
+         Node::printError(location, "undeclared variable '" + lhs->getStructName() + "'");
+         context.addError();
+         return nullptr;
+      }
+      if (context.isSoaType(varStruct->getAllocatedType())) {
+         auto soa = new LoadInst(varStruct->getAllocatedType(), varStruct, lhs->getStructName(), context.currentBlock());
+         return codeGenSoaColumn(soa, value, context);
       }
       std::string  klassName = context.getType(lhs->getStructName());
+      if (!checkMemberValue(klassName, value, context)) {
+         return nullptr;
+      }
       Instruction* ptr       = context.getKlassVarAccessInst(klassName, lhs->getName(), varStruct);
-      return new StoreInst(value, ptr, false, context.currentBlock());
+      // The object may outlive the list a view is taken from.
+      value = context.escapingArray(value);
+      return new StoreInst(value, ptr, false, context.getKlassMemberAlign(klassName, lhs->getName()), context.currentBlock());
    }
    Type* varType = var->getAllocatedType();
+   if (context.isArrayType(varType) && value->getType() != varType) {
+      // A list of numbers or an int[] can be assigned to a typed array.
+      auto array = context.convertToArray(value, varType);
+      if (array == nullptr) {
+         Node::printError(location, " Assignment of incompatible types, " + lhs->getName() + " is a " + context.typeNameOf(varType) + ".");
+         context.addError();
+         return nullptr;
+      }
+      value = array;
+   }
+   if (context.isArrayType(varType) && context.isSoaColumnView(value)) {
+      // The column moves when a record is added, the variable gets the elements.
+      value = context.copyArray(value);
+   }
+   if (context.isArrayType(varType) && context.mayBeStackView(value)) {
+      context.addStackView(var);
+   }
+   if ((context.isMapType(varType) || context.isSoaType(varType)) && value->getType() != varType) {
+      Node::printError(location, " Assignment of incompatible types, " + lhs->getName() + " is a " + context.typeNameOf(varType) + ".");
+      context.addError();
+      return nullptr;
+   }
+   if (varType->isPointerTy()) {
+      // Strings, objects and lists on the stack are all pointers, a variable of a class only gets an object of its class.
+      auto klass   = context.getType(lhs->getName());
+      bool isKlass = context.isClass(klass);
+      if (isKlass ? context.getObjectClassName(value) != klass : !context.isString(value) && !isa<AllocaInst>(value)) {
+         Node::printError(location, " Assignment of incompatible types, " + lhs->getName() + " is a " + (isKlass ? klass : "string") + ".");
+         context.addError();
+         return nullptr;
+      }
+   }
    if (value->getType()->getTypeID() == varType->getTypeID()) {
       // same type but different bit size.
       if (value->getType()->getScalarSizeInBits() > varType->getScalarSizeInBits()) {
@@ -85,4 +118,44 @@ Value* Assignment::codeGen(CodeGenContext& context)
    return new StoreInst(value, var, false, context.currentBlock());
 }
 
+bool Assignment::checkMemberValue(const std::string& klassName, llvm::Value* value, CodeGenContext& context)
+{
+   if (!context.isClass(klassName) || !context.hasKlassMember(klassName, lhs->getName())) {
+      return true;
+   }
+   // A string instance variable gets a string, an object isn't stored into any other instance variable.
+   Type* memberType = context.getKlassMemberType(klassName, lhs->getName());
+   bool  isString   = memberType->isPointerTy();
+   if (isString ? context.isString(value) : context.getObjectClassName(value).empty()) {
+      return true;
+   }
+   auto typeName = isString ? std::string("string") : context.findClassNameByType(memberType);
+   Node::printError(location, " Assignment of incompatible types, " + lhs->getStructName() + "." + lhs->getName() + " is a " +
+                                 (typeName.empty() ? context.typeNameOf(memberType) : typeName) + ".");
+   context.addError();
+   return false;
+}
+
+llvm::Value* Assignment::codeGenSoaColumn(llvm::Value* soa, llvm::Value* value, CodeGenContext& context)
+{
+   auto column = context.soaColumn(soa, lhs->getName());
+   if (column == nullptr) {
+      Node::printError(location, " class " + context.getSoaClassName(soa->getType()) + " has no instance variable " + lhs->getName());
+      context.addError();
+      return nullptr;
+   }
+   auto array = context.convertToArray(value, column->getType());
+   if (array == nullptr) {
+      Node::printError(location, " Assignment of incompatible types, " + lhs->getStructName() + "." + lhs->getName() + " is a " + context.typeNameOf(column->getType()) + ".");
+      context.addError();
+      return nullptr;
+   }
+   // The elements are copied into the column, up to the shorter length of both.
+   IRBuilder<> builder(context.currentBlock());
+   auto        count       = builder.CreateBinaryIntrinsic(Intrinsic::smin, builder.CreateExtractValue(column, {1}), builder.CreateExtractValue(array, {1}), nullptr, "count");
+   auto        elementSize = context.getModule()->getDataLayout().getTypeAllocSize(context.getArrayElementType(column->getType()));
+   auto        bytes       = builder.CreateMul(count, builder.getInt64(elementSize), "bytes");
+   return builder.CreateMemMove(builder.CreateExtractValue(column, {0}), MaybeAlign(8), builder.CreateExtractValue(array, {0}), MaybeAlign(8), bytes);
+}
+
 } // namespace liquid
@@ -26,8 +26,17 @@ public:
    void Accept(Visitor& v) override { v.VisitAssigment(this); }
 
    Expression* getExpression() { return rhs; }
+   Identifier* getIdentifier() { return lhs; }
 
 private:
+   /*! Copies the elements of a typed array into a column of a struct of arrays. */
+   llvm::Value* codeGenSoaColumn(llvm::Value* soa, llvm::Value* value, CodeGenContext& context);
+
+   /*! Checks a string is assigned to a string instance variable and no object to any other instance variable.
+    * \return false after the error is reported.
+    */
+   bool checkMemberValue(const std::string& klassName, llvm::Value* value, CodeGenContext& context);
+
    Identifier* lhs{nullptr};
    Expression* rhs{nullptr};
    YYLTYPE     location;
@@ -2,6 +2,8 @@
 #include <sstream>
 #include "AstNode.h"
 #include "CodeGenContext.h"
+#include "LoopControl.h"
+#include "Return.h"
 #include "parser.hpp"
 
 
@@ -22,28 +24,8 @@ Value* Double::codeGen(CodeGenContext& context)
 
 Value* String::codeGen(CodeGenContext& context)
 {
-    // generate the type for the global var
-    ArrayType* ArrayTy_0 = ArrayType::get(IntegerType::get(context.getGlobalContext(), 8), value.size() +1 );
-    // create global var which holds the constant string.
-    GlobalVariable* gvar_array__str = new GlobalVariable(*context.getModule(),
-                                                         /*Type=*/ArrayTy_0,
-                                                         /*isConstant=*/true,
-                                                         GlobalValue::PrivateLinkage,
-                                                         /*Initializer=*/0, // has initializer, specified below
-                                                         ".str");
-    gvar_array__str->setAlignment(MaybeAlign(1));
-    // create the contents for the string global.
-    Constant* const_array_str =  ConstantDataArray::getString(context.getGlobalContext(), value);
-    // Initialize the global with the string
-    gvar_array__str->setInitializer(const_array_str);
-
-    // generate access pointer to the string
-    std::vector<Constant*> const_ptr_8_indices;
-    ConstantInt* const_int = ConstantInt::get(context.getGlobalContext(), APInt(64, StringRef("0"), 10));
-    const_ptr_8_indices.push_back(const_int);
-    const_ptr_8_indices.push_back(const_int);
-    Constant* const_ptr_8 = ConstantExpr::getGetElementPtr(ArrayTy_0, gvar_array__str, const_ptr_8_indices);
-    return const_ptr_8;
+    // The literals are interned, every occurrence of the same string uses one global.
+    return context.getStringLiteral(value);
 }
 
 Value* Boolean::codeGen(CodeGenContext& context)
@@ -59,15 +41,30 @@ Value* Identifier::codeGen(CodeGenContext& context)
         if (alloc != nullptr) {
             return new LoadInst(alloc->getAllocatedType(), alloc, name, false, context.currentBlock());
         }
+        // A variable, which is never assigned, is its value.
+        Value* value = context.findImmutable(name);
+        if (value != nullptr) {
+            return value;
+        }
     } else {
         // get this ptr of struct/class etc...
         // it is a stack variable which is a reference to a class object
         AllocaInst* alloc = context.findVariable(structName);
+        if (alloc != nullptr && context.isSoaType(alloc->getAllocatedType())) {
+            // The column of a struct of arrays.
+            auto soa = new LoadInst(alloc->getAllocatedType(), alloc, structName, false, context.currentBlock());
+            auto column = context.soaColumn(soa, name);
+            if (column == nullptr) {
+                Node::printError(location, "class " + context.getSoaClassName(soa->getType()) + " has no instance variable " + name);
+                context.addError();
+            }
+            return column;
+        }
         if (alloc != nullptr) {
             std::string klassName = context.getType(structName);
             Instruction * ptr = context.getKlassVarAccessInst(klassName, name, alloc);
             auto Ty = context.getKlassMemberType(klassName, name);
-            return new LoadInst(Ty, ptr, name, false, context.currentBlock());
+            return new LoadInst(Ty, ptr, name, false, context.getKlassMemberAlign(klassName, name), context.currentBlock());
         }
     }
     Node::printError(location, "undeclared variable " + structName + "::" + name );
@@ -78,8 +75,20 @@ Value* Identifier::codeGen(CodeGenContext& context)
 Value* Block::codeGen(CodeGenContext& context)
 {
     Value *last = nullptr;
-    for ( auto s : statements) {
-        last = s->codeGen(context);
+    for ( auto it = statements.begin(); it != statements.end(); ++it ) {
+        last = (*it)->codeGen(context);
+        if ( std::next(it) != statements.end() && context.currentBlock()->getTerminator() != nullptr ) {
+            // A break, continue or return ends the basic block, no code may follow it.
+            std::string msg = " Warning: The statements after " + (*it)->toString() + "are never executed and are skipped.";
+            if ( auto loopControl = dynamic_cast<LoopControl*>(*it) ) {
+                Node::printError(loopControl->getLocation(), msg);
+            } else if ( auto ret = dynamic_cast<Return*>(*it) ) {
+                Node::printError(ret->getLocation(), msg);
+            } else {
+                Node::printError(msg);
+            }
+            break;
+        }
     }
     return last;
 }
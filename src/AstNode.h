@@ -3,6 +3,7 @@
 
 #include "main.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -38,6 +39,7 @@ class CodeGenContext;
 using StatementList = std::vector<class Statement*>;
 using ExpressionList = std::vector<class Expression*>;
 using VariableList = std::vector<class VariableDeclaration*>;
+using MatchCaseList = std::vector<class MatchCase*>;
 
 /*! Type of the AST node */
 enum class NodeType
@@ -52,7 +54,8 @@ enum class NodeType
     boolean,
     identifier,
     list,
-    range
+    range,
+    binaryop
 };
 
 /*! Base class of all nodes */
@@ -117,6 +120,13 @@ public:
    NodeType    getType() override { return NodeType::expression; }
    std::string toString() override { return "Statement"; }
    void        Accept(Visitor& v) override { v.VisitStatement(this); }
+   /*! Adds an annotation (@name) given in front of the declaration, the name is w/o @. */
+   void        addAnnotation(const std::string& name) { annotations.push_back(name); }
+   bool        hasAnnotation(const std::string& name) const { return std::find(annotations.begin(), annotations.end(), name) != annotations.end(); }
+   const std::vector<std::string>& getAnnotations() const { return annotations; }
+
+protected:
+   std::vector<std::string> annotations;
 };
 
 /*! Represents an integer. */
@@ -135,6 +145,8 @@ public:
    }
    void Accept(Visitor& v) override { v.VisitInteger(this); }
 
+   long long getValue() const { return value; }
+
 private:
    long long value{0};
 };
@@ -175,6 +187,8 @@ public:
    }
    void Accept(Visitor& v) override { v.VisitString(this); }
 
+   const std::string& getValue() const { return value; }
+
 private:
    std::string value;
 };
@@ -1,8 +1,9 @@
 #include "BinaryOperator.h"
 #include "CodeGenContext.h"
-#include "Array.h"
 #include "parser.hpp"
 
+#include <algorithm>
+
 using namespace llvm;
 
 namespace liquid
@@ -10,15 +11,47 @@ namespace liquid
 
 Value* BinaryOp::codeGen(CodeGenContext& context)
 {
+   if (op == TAND || op == TOR) {
+      return codeGenLogical(context);
+   }
    Value* rhsValue = rhs->codeGen(context);
+   if (rhsValue == nullptr) {
+      return nullptr;
+   }
+   if (op == TPLUS && listTypeOf(rhsValue, context) != nullptr) {
+      // A list concatenation, the whole chain a + b + c is done at once.
+      return codeGenAddList(rhsValue, context);
+   }
    Value* lhsValue = lhs->codeGen(context);
-   if ((rhsValue == nullptr) || (lhsValue == nullptr)) {
+   if (lhsValue == nullptr) {
+      return nullptr;
+   }
+   if (context.isArrayType(rhsValue->getType()) || context.isArrayType(lhsValue->getType())) {
+      // Element-wise operation on typed arrays.
+      return codeGenArrayOp(rhsValue, lhsValue, context);
+   }
+   if (!context.getObjectClassName(rhsValue).empty() || !context.getObjectClassName(lhsValue).empty()) {
+      Node::printError(location, "Binary operation on a class object is not supported.");
+      context.addError();
+      return nullptr;
+   }
+   if (context.isString(rhsValue) || context.isString(lhsValue)) {
+      if (op != TPLUS || !context.isString(rhsValue) || !context.isString(lhsValue)) {
+         Node::printError(location, "Only the addition of two strings is supported.");
+         context.addError();
+         return nullptr;
+      }
+      return context.callBuiltin("liq_str_concat", {lhsValue, rhsValue});
+   }
+   if (listTypeOf(rhsValue, context) != nullptr || listTypeOf(lhsValue, context) != nullptr) {
+      Node::printError(location, op == TPLUS ? "Both operands must be lists." : "Only operator addition is currently supported on lists.");
+      context.addError();
       return nullptr;
    }
-   auto Ty = rhsValue->getType();
-   if ( Ty->isStructTy() ) {
-      // A class or list object is added.
-      return codeGenAddList(rhsValue, lhsValue, context);
+   if (rhsValue->getType()->isStructTy() || lhsValue->getType()->isStructTy()) {
+      Node::printError(location, "Binary operation on a class object is not supported.");
+      context.addError();
+      return nullptr;
    }
 
    if (rhsValue->getType() != lhsValue->getType()) {
@@ -31,12 +64,6 @@ Value* BinaryOp::codeGen(CodeGenContext& context)
    }
 
    bool isDoubleTy = rhsValue->getType()->isFloatingPointTy();
-   if (isDoubleTy && (op == TAND || op == TOR)) {
-      Node::printError(location, "Binary operation (AND,OR) on floating point value is not supported. Is a cast missing?");
-      context.addError();
-      return nullptr;
-   }
-
    Instruction::BinaryOps instr;
    switch (op) {
       case TPLUS:
@@ -51,18 +78,12 @@ Value* BinaryOp::codeGen(CodeGenContext& context)
       case TDIV:
          isDoubleTy ? instr = Instruction::FDiv : instr = Instruction::SDiv;
          break;
-      case TAND:
-         instr = Instruction::And;
-         break;
-      case TOR:
-         instr = Instruction::Or;
-         break;
       default:
          Node::printError(location, "Unknown binary operator.");
          context.addError();
          return nullptr;
    }
-   return BinaryOperator::Create(instr, lhsValue, rhsValue, "mathtmp", context.currentBlock());
+   return context.applyFastMath(BinaryOperator::Create(instr, lhsValue, rhsValue, "mathtmp", context.currentBlock()));
 }
 
 std::string BinaryOp::toString()
@@ -94,49 +115,231 @@ std::string BinaryOp::toString()
    return s.str();
 }
 
-llvm::Value* BinaryOp::codeGenAddList(llvm::Value* rhsValue, llvm::Value* lhsValue, CodeGenContext& context)
+llvm::Value* BinaryOp::codeGenLogical(CodeGenContext& context)
 {
-   auto rhsTy = rhsValue->getType();
-   auto lhsTy = lhsValue->getType();
-   if (!lhsTy->isStructTy()) {
-      Node::printError(location, "First operand is not of a list type.");
+   // The operands are evaluated from left to right.
+   Value* lhsValue = lhs->codeGen(context);
+   if (lhsValue == nullptr) {
       return nullptr;
    }
-   if (!rhsTy->isStructTy()) {
-      Node::printError(location, "Second operand is not of a list type.");
+   if (!lhsValue->getType()->isIntegerTy()) {
+      Node::printError(location, "Binary operation (AND,OR) is only supported on boolean and integer values. Is a cast missing?");
+      context.addError();
       return nullptr;
    }
+   if (!lhsValue->getType()->isIntegerTy(1)) {
+      // Integers are combined bitwise, so both operands are needed.
+      Value* rhsValue = rhs->codeGen(context);
+      if (rhsValue == nullptr) {
+         return nullptr;
+      }
+      if (rhsValue->getType() != lhsValue->getType()) {
+         Node::printError(location, "Both operands of a binary operation (AND,OR) must be integers.");
+         context.addError();
+         return nullptr;
+      }
+      return BinaryOperator::Create(op == TAND ? Instruction::And : Instruction::Or, lhsValue, rhsValue, "mathtmp", context.currentBlock());
+   }
 
-   if (getLHS()->getType() != NodeType::identifier) {
-      Node::printError(location, "First operand must be an identifier.");
+   // A boolean left operand may decide the result, then the right one isn't evaluated.
+   auto        boolTy     = lhsValue->getType();
+   auto        name       = op == TAND ? "and" : "or";
+   Function*   function   = context.currentBlock()->getParent();
+   BasicBlock* lhsBlock   = context.currentBlock();
+   BasicBlock* rhsBlock   = BasicBlock::Create(context.getGlobalContext(), std::string(name) + "_rhs", function);
+   BasicBlock* mergeBlock = BasicBlock::Create(context.getGlobalContext(), std::string(name) + "_merge");
+   context.setInsertPoint(rhsBlock);
+   Value* rhsValue = rhs->codeGen(context);
+   if (rhsValue == nullptr) {
+      delete mergeBlock;
       return nullptr;
    }
-   if (getRHS()->getType() != NodeType::identifier) {
-      Node::printError(location, "Second operand must be an identifier.");
+   if (!rhsValue->getType()->isIntegerTy(1)) {
+      Node::printError(location, "Both operands of a binary operation (AND,OR) must be booleans.");
+      context.addError();
+      delete mergeBlock;
       return nullptr;
    }
-   if (op != TPLUS) {
-      Node::printError(location, "Only operator addition is currently supported.");
+   BasicBlock* rhsEnd = context.currentBlock();
+
+   if (rhsEnd == rhsBlock && context.isSpeculatable(rhsBlock)) {
+      // The right operand is cheap and can't fail, evaluating it anyway is cheaper than a branch.
+      delete mergeBlock;
+      lhsBlock->splice(lhsBlock->end(), rhsBlock);
+      rhsBlock->eraseFromParent();
+      context.setInsertPoint(lhsBlock);
+      if (op == TAND) {
+         return SelectInst::Create(lhsValue, rhsValue, ConstantInt::getFalse(boolTy), name, lhsBlock);
+      }
+      return SelectInst::Create(lhsValue, ConstantInt::getTrue(boolTy), rhsValue, name, lhsBlock);
+   }
+
+   if (op == TAND) {
+      BranchInst::Create(rhsBlock, mergeBlock, lhsValue, lhsBlock);
+   } else {
+      BranchInst::Create(mergeBlock, rhsBlock, lhsValue, lhsBlock);
+   }
+   BranchInst::Create(mergeBlock, rhsEnd);
+   function->insert(function->end(), mergeBlock);
+   context.setInsertPoint(mergeBlock);
+   auto result = PHINode::Create(boolTy, 2, name, mergeBlock);
+   result->addIncoming(ConstantInt::getBool(boolTy, op == TOR), lhsBlock);
+   result->addIncoming(rhsValue, rhsEnd);
+   return result;
+}
+
+llvm::StructType* BinaryOp::listTypeOf(llvm::Value* value, CodeGenContext& context)
+{
+   Type* ty    = value->getType();
+   auto alloca = dyn_cast<AllocaInst>(value);
+   if (alloca != nullptr) {
+      ty = alloca->getAllocatedType();
+   }
+   if (!ty->isStructTy() || context.isArrayType(ty) || context.isMapType(ty) || context.isSoaType(ty) || !context.findClassNameByType(ty).empty() || ty == context.typeOf("var")) {
       return nullptr;
    }
+   return cast<StructType>(ty);
+}
+
+llvm::Value* BinaryOp::codeGenAddList(llvm::Value* rhsValue, CodeGenContext& context)
+{
+   // Collect the operands of the chain ((a + b) + c) from right to left, which is the evaluation order.
+   std::vector<Expression*> operands;
+   Expression*              expr = lhs;
+   while (expr->getType() == NodeType::binaryop) {
+      auto binop = static_cast<BinaryOp*>(expr);
+      if (binop->getOperator() != TPLUS) {
+         break;
+      }
+      operands.push_back(binop->getRHS());
+      expr = binop->getLHS();
+   }
+   operands.push_back(expr);
+
+   std::vector<Value*> values{rhsValue};
+   for (auto operand : operands) {
+      auto value = operand->codeGen(context);
+      if (value == nullptr) {
+         return nullptr;
+      }
+      if (listTypeOf(value, context) == nullptr) {
+         Node::printError(location, "Operand " + operand->toString() + " is not of a list type.");
+         context.addError();
+         return nullptr;
+      }
+      values.push_back(value);
+   }
+   std::reverse(values.begin(), values.end());
+   for (auto& value : values) {
+      // A list variable is copied from its alloca instead of loading the whole list first.
+      auto load = dyn_cast<LoadInst>(value);
+      if (load != nullptr && isa<AllocaInst>(load->getPointerOperand()) && load->use_empty()) {
+         value = load->getPointerOperand();
+         load->eraseFromParent();
+      }
+   }
+
+   std::vector<Type*>       types;
+   std::vector<std::string> liquidTypes;
+   for (auto value : values) {
+      auto listTy = listTypeOf(value, context);
+      types.insert(types.end(), listTy->element_begin(), listTy->element_end());
+      for (unsigned i = 0; i < listTy->getNumElements(); ++i) {
+         liquidTypes.push_back(context.getListElementType(value, i));
+      }
+   }
+   auto resultTy = StructType::get(context.getGlobalContext(), types);
+   auto result   = new AllocaInst(resultTy, 0, "alloc_list", context.currentBlock());
+   context.setListElementTypes(result, std::move(liquidTypes));
+   auto& layout  = context.getModule()->getDataLayout();
+   auto  int32Ty = Type::getInt32Ty(context.getGlobalContext());
+   bool  homogeneous = std::all_of(types.begin(), types.end(), [&](Type* ty) { return ty == types.front(); });
 
-   // Construct a new list with the contents of the both.
-   auto           rhsCount = rhsTy->getNumContainedTypes();
-   auto           lhsCount = lhsTy->getNumContainedTypes();
-   ExpressionList exprList;
-   for (unsigned int i = 0; i < lhsCount; ++i) {
-      auto         id     = (Identifier*)this->getLHS();
-      ArrayAccess* access = new ArrayAccess(id, i, id->getLocation());
-      exprList.push_back(access);
+   if (homogeneous) {
+      // All elements have the same type, so each operand is a contiguous part of the result.
+      IRBuilder<> builder(context.currentBlock());
+      unsigned    start = 0;
+      for (auto value : values) {
+         auto listTy = listTypeOf(value, context);
+         if (listTy->getNumElements() != 0) {
+            auto dest = GetElementPtrInst::Create(resultTy, result, {ConstantInt::get(int32Ty, 0), ConstantInt::get(int32Ty, start)}, "concat_dest", context.currentBlock());
+            if (isa<AllocaInst>(value)) {
+               builder.SetInsertPoint(context.currentBlock());
+               builder.CreateMemCpy(dest, layout.getPrefTypeAlign(types.front()), value, cast<AllocaInst>(value)->getAlign(), layout.getTypeAllocSize(listTy));
+            } else {
+               new StoreInst(value, dest, context.currentBlock());
+            }
+         }
+         start += listTy->getNumElements();
+      }
+      return result;
    }
-   for (unsigned int i = 0; i < rhsCount; ++i) {
-      auto         id     = (Identifier*)this->getRHS();
-      ArrayAccess* access = new ArrayAccess(id, i, id->getLocation());
-      exprList.push_back(access);
+
+   // Different element types, the layouts differ, copy element by element into the new struct.
+   Value*   aggregate = PoisonValue::get(resultTy);
+   unsigned index     = 0;
+   for (auto value : values) {
+      auto listTy = listTypeOf(value, context);
+      if (isa<AllocaInst>(value)) {
+         value = new LoadInst(listTy, value, "list", context.currentBlock());
+      }
+      for (unsigned i = 0; i < listTy->getNumElements(); ++i) {
+         auto element = ExtractValueInst::Create(value, {i}, "", context.currentBlock());
+         aggregate    = InsertValueInst::Create(aggregate, element, {index++}, "", context.currentBlock());
+      }
    }
-   auto list    = new Array(&exprList, location);
-   auto newList = list->codeGen(context);
-   return newList;
+   new StoreInst(aggregate, result, context.currentBlock());
+   return result;
+}
+
+llvm::Value* BinaryOp::codeGenArrayOp(llvm::Value* rhsValue, llvm::Value* lhsValue, CodeGenContext& context)
+{
+   if (!context.isArrayType(lhsValue->getType()) || !context.isArrayType(rhsValue->getType())) {
+      Node::printError(location, "Both operands must be arrays.");
+      context.addError();
+      return nullptr;
+   }
+   std::string kernel;
+   switch (op) {
+      case TPLUS:
+         kernel = "liq_add";
+         break;
+      case TMINUS:
+         kernel = "liq_sub";
+         break;
+      case TMUL:
+         kernel = "liq_mul";
+         break;
+      case TDIV:
+         kernel = "liq_div";
+         break;
+      default:
+         Node::printError(location, "Only + - * / are supported on arrays.");
+         context.addError();
+         return nullptr;
+   }
+
+   if (rhsValue->getType() != lhsValue->getType()) {
+      // int[] and double[] are calculated as double[].
+      auto doubleArrayTy = context.getArrayType(Type::getDoubleTy(context.getGlobalContext()));
+      rhsValue           = context.convertToArray(rhsValue, doubleArrayTy);
+      lhsValue           = context.convertToArray(lhsValue, doubleArrayTy);
+   }
+   auto arrayTy = lhsValue->getType();
+   kernel += context.getArrayElementType(arrayTy)->isDoubleTy() ? "_f64" : "_i64";
+
+   // The result has the length of the shorter one.
+   auto block   = context.currentBlock();
+   auto lhsLen  = ExtractValueInst::Create(lhsValue, {1}, "len", block);
+   auto rhsLen  = ExtractValueInst::Create(rhsValue, {1}, "len", block);
+   auto less    = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_SLT, lhsLen, rhsLen, "cmp_len", block);
+   auto count   = SelectInst::Create(less, lhsLen, rhsLen, "len", block);
+   auto result  = context.createArray(arrayTy, count);
+   auto outData = ExtractValueInst::Create(result, {0}, "data", block);
+   auto lhsData = ExtractValueInst::Create(lhsValue, {0}, "data", block);
+   auto rhsData = ExtractValueInst::Create(rhsValue, {0}, "data", block);
+   context.callBuiltin(kernel, {outData, lhsData, rhsData, count});
+   return result;
 }
 
 } // namespace liquid
@@ -4,7 +4,7 @@
 
 namespace liquid
 {
-/*! Represents a binary operators  + - * / */
+/*! Represents a binary operators  + - * / and or */
 class BinaryOp : public Expression
 {
 public:
@@ -16,7 +16,7 @@ public:
    }
 
    llvm::Value* codeGen(CodeGenContext& context) override;
-   NodeType     getType() override { return NodeType::expression; }
+   NodeType     getType() override { return NodeType::binaryop; }
    std::string  toString() override;
    void         Accept(Visitor& v) override { v.VisitBinaryOp(this); }
 
@@ -25,7 +25,15 @@ public:
    int         getOperator() const { return op; }
 
 private:
-   llvm::Value* codeGenAddList(llvm::Value* rhsValue, llvm::Value* lhsValue, CodeGenContext& context);
+   /*! Returns the struct type if value is a list (on the stack or as value) otherwise nullptr. */
+   static llvm::StructType* listTypeOf(llvm::Value* value, CodeGenContext& context);
+
+   /*! Concatenates the lists of a chain like a + b + c into one new list. */
+   llvm::Value* codeGenAddList(llvm::Value* rhsValue, CodeGenContext& context);
+   llvm::Value* codeGenArrayOp(llvm::Value* rhsValue, llvm::Value* lhsValue, CodeGenContext& context);
+
+   /*! Generates and/or, on booleans the right operand is only evaluated if the left one doesn't decide the result. */
+   llvm::Value* codeGenLogical(CodeGenContext& context);
 
    int         op{0};
    Expression* lhs{nullptr};
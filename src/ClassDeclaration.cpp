@@ -24,21 +24,103 @@ namespace liquid {
 Value* ClassDeclaration::codeGen( CodeGenContext& context )
 {
     std::vector<Type*> StructTy_fields;
+    if( !checkAnnotations( context ) ) {
+        return nullptr;
+    }
     context.newKlass( id->getName() );
     constructStructFields( StructTy_fields, context );
-    auto classTy = StructType::create( context.getGlobalContext(), StructTy_fields, std::string( "class." ) + id->getName(), /*isPacked=*/false );
+    auto classTy = StructType::create( context.getGlobalContext(), StructTy_fields, std::string( "class." ) + id->getName(), hasAnnotation( "packed" ) );
     addVarsToClassAttributes( context, StructTy_fields );
+    if( context.verbose ) {
+        printLayout( context, classTy );
+    }
     removeVarDeclStatements();
     context.addClassType(id->getName(), classTy);
+    // Declared before the methods, a method may declare an object of its own class.
+    Function* constructor = declareConstructor( context );
     Value* retval = block->codeGen( context );
+    createConstructor( context, constructor );
     context.endKlass();
     return retval;
 }
 
+Function* ClassDeclaration::declareConstructor( CodeGenContext& context )
+{
+    std::string klassName = id->getName();
+    Type* self_ptr_ty = PointerType::get( context.typeOf( klassName ), 0 );
+    FunctionType* ftype = FunctionType::get( Type::getVoidTy( context.getGlobalContext() ), { self_ptr_ty }, false );
+    Function* function = Function::Create( ftype, GlobalValue::InternalLinkage, "__construct%" + klassName, context.getModule() );
+    context.addCallTarget( "__construct", klassName, function );
+    return function;
+}
+
+void ClassDeclaration::createConstructor( CodeGenContext& context, Function* function )
+{
+    // The constructor __construct%Class runs the member initializers in the order of their declaration
+    // and then the __init__ method. Each declaration of an object calls it.
+    std::string klassName = id->getName();
+    Type* self_ptr_ty = PointerType::get( context.typeOf( klassName ), 0 );
+    BasicBlock* bblock = BasicBlock::Create( context.getGlobalContext(), "entry", function, 0 );
+    context.newScope( bblock, ScopeType::FunctionDeclaration );
+
+    Argument* self = function->arg_begin();
+    self->setName( "this" );
+    AllocaInst* alloca = new AllocaInst( self_ptr_ty, 0, "self_addr", context.currentBlock() );
+    new StoreInst( self, alloca, context.currentBlock() );
+    context.locals()["self"] = alloca;
+    context.setLiquidType( alloca, klassName );
+
+    for( auto assign : context.getKlassInitCode( klassName ) ) {
+        assign->codeGen( context );
+    }
+    Function* init = context.findCallTarget( "__init__", klassName, 0 );
+    if( init != nullptr ) {
+        auto call = CallInst::Create( init, { self }, "", context.currentBlock() );
+        call->setCallingConv( init->getCallingConv() );
+    }
+    ReturnInst::Create( context.getGlobalContext(), context.currentBlock() );
+    context.endScope();
+}
+
+bool ClassDeclaration::checkAnnotations( CodeGenContext& context )
+{
+    bool valid = true;
+    for( auto& name : annotations ) {
+        if( name != "ordered" && name != "packed" ) {
+            Node::printError( id->getLocation(), " Unknown annotation @" + name + " of class " + id->getName() );
+            context.addError();
+            valid = false;
+        }
+    }
+    if( hasAnnotation( "ordered" ) && hasAnnotation( "packed" ) ) {
+        Node::printError( id->getLocation(), " Class " + id->getName() + " can't be @ordered and @packed" );
+        context.addError();
+        valid = false;
+    }
+    for( auto statement : block->statements ) {
+        if( statement->getType() != NodeType::variable ) {
+            continue;
+        }
+        #if defined(LIQ_NO_RTTI)
+        VariableDeclaration* vardecl = (VariableDeclaration*) statement;
+        #else
+        VariableDeclaration* vardecl = dynamic_cast< VariableDeclaration* >(statement);
+        #endif
+        for( auto& name : vardecl->getAnnotations() ) {
+            if( name != "hot" ) {
+                Node::printError( vardecl->getLocation(), " Unknown annotation @" + name + " of instance variable " + vardecl->getVariablenName() );
+                context.addError();
+                valid = false;
+            }
+        }
+    }
+    return valid;
+}
+
 void ClassDeclaration::constructStructFields( std::vector<llvm::Type* >& StructTy_fields, CodeGenContext& context )
 {
-    auto structName = id->getName();
     // Get all variables and put them in the struct vector.
+    fields.clear();
     for( auto statement : block->statements ) {
         if( statement->getType() == NodeType::variable ) {
             // Type Definitions
@@ -47,14 +129,50 @@ void ClassDeclaration::constructStructFields( std::vector<llvm::Type* >& StructT
             #else
             VariableDeclaration* vardecl = dynamic_cast< VariableDeclaration* >(statement);
             #endif
-            StructTy_fields.push_back( context.typeOf( vardecl->getIdentifierOfVariablenType() ) );
+            fields.push_back( vardecl );
+        }
+    }
+    // The @hot variables come first, so they share the first cache line.
+    // Unless the class is @ordered, the variables are sorted by their alignment and size, which leaves
+    // no padding between them. A @packed class also has no padding at the end. Its fields after a @hot one may
+    // be misaligned then, they are read and written with the alignment their offset allows.
+    auto& dataLayout = context.getModule()->getDataLayout();
+    bool sortBySize = !hasAnnotation( "ordered" );
+    std::stable_sort( fields.begin(), fields.end(), [&]( VariableDeclaration* a, VariableDeclaration* b ) {
+        if( a->hasAnnotation( "hot" ) != b->hasAnnotation( "hot" ) ) {
+            return a->hasAnnotation( "hot" );
+        }
+        if( !sortBySize ) {
+            return false;
+        }
+        Type* tyA = context.typeOf( a->getIdentifierOfVariablenType() );
+        Type* tyB = context.typeOf( b->getIdentifierOfVariablenType() );
+        if( dataLayout.getABITypeAlign( tyA ) != dataLayout.getABITypeAlign( tyB ) ) {
+            return dataLayout.getABITypeAlign( tyA ) > dataLayout.getABITypeAlign( tyB );
+        }
+        return dataLayout.getTypeAllocSize( tyA ) > dataLayout.getTypeAllocSize( tyB );
+    } );
+    for( auto vardecl : fields ) {
+        StructTy_fields.push_back( context.typeOf( vardecl->getIdentifierOfVariablenType() ) );
+    }
+}
+
+void ClassDeclaration::printLayout( CodeGenContext& context, StructType* classTy )
+{
+    auto& outs = context.getOutput();
+    auto structLayout = context.getModule()->getDataLayout().getStructLayout( classTy );
+    outs << "Layout of class " << id->getName() << " (" << structLayout->getSizeInBytes() << " bytes):\n";
+    for( unsigned i = 0; i < fields.size(); ++i ) {
+        outs << "  " << structLayout->getElementOffset( i ) << ": " << fields[i]->getVariablenTypeName() << " " << fields[i]->getVariablenName();
+        if( fields[i]->hasAnnotation( "hot" ) ) {
+            outs << " @hot";
         }
+        outs << "\n";
     }
 }
 
 void ClassDeclaration::addVarsToClassAttributes( CodeGenContext& context, std::vector<llvm::Type*>& StructTy_fields )
 {
-    int index = 0;
     for( auto statement : block->statements ) {
         if( statement->getType() == NodeType::variable ) {
             std::string klassName = this->id->getName();
@@ -65,18 +183,18 @@ void ClassDeclaration::addVarsToClassAttributes( CodeGenContext& context, std::v
             VariableDeclaration* vardecl = dynamic_cast< VariableDeclaration* >(statement);
             #endif
             std::string varName = vardecl->getVariablenName();
+            // The index of the struct field, the initial values are assigned in the order of the declaration.
+            int index = static_cast<int>( std::find( fields.begin(), fields.end(), vardecl ) - fields.begin() );
             context.klassAddVariableAccess( varName, index, StructTy_fields[index] );
             if( vardecl->hasAssignmentExpr() ) {
-                // call the assignments when class is instantiated.
-                // Copy it to a place, so that it can be execute at the init time of the class.
+                // The assignment is run by the constructor of the class as self.member = expression.
                 auto assignmentExpr = vardecl->getAssignment();
                 auto ident = vardecl->getIdentifierOfVariable();
-                Identifier* newident = new Identifier( klassName, ident.getName(), ident.getLocation() );
+                Identifier* newident = new Identifier( "self", ident.getName(), ident.getLocation() );
 
                 auto assn = new Assignment( newident, assignmentExpr, vardecl->getLocation() );
                 context.addKlassInitCode( klassName, assn );
             }
-            ++index;
         }
     }
 
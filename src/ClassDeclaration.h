@@ -27,12 +27,18 @@ public:
     Block*      getBlock() { return block; }
     Identifier* getIdentifier() { return id; }
 private:
+    bool checkAnnotations(CodeGenContext& context);
     void removeVarDeclStatements();
     void constructStructFields(std::vector<llvm::Type*>& StructTy_fields, CodeGenContext& context);
     void addVarsToClassAttributes(CodeGenContext& context, std::vector<llvm::Type*>& StructTy_fields);
+    /*! Declares the constructor __construct%Class, its body is created by createConstructor after the methods. */
+    llvm::Function* declareConstructor(CodeGenContext& context);
+    void createConstructor(CodeGenContext& context, llvm::Function* function);
+    void printLayout(CodeGenContext& context, llvm::StructType* classTy);
 
     Identifier* id{nullptr};
     Block*      block{nullptr};
+    std::vector<VariableDeclaration*> fields; ///< The instance variables in the order of the struct fields.
 };
 
 
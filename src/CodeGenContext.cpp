@@ -2,6 +2,7 @@
 #include <typeinfo>
 #include "AstNode.h"
 #include "CodeGenContext.h"
+#include "Declaration.h"
 #include "parser.hpp"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -13,14 +14,28 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/ExecutionEngine/Interpreter.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IRBuilder.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <algorithm>
 #include <cmath>
+#include <iostream>
 
 #include "buildins.h"
 #include "VisitorSyntaxCheck.h"
 #include "VisitorPrettyPrint.h"
+#include "VisitorAssignedVariables.h"
 
 using namespace std;
 using namespace llvm;
@@ -50,9 +65,129 @@ CodeGenContext::CodeGenContext(std::ostream& outs) : outs(outs)
    llvm::InitializeNativeTargetAsmParser();
    llvm::InitializeNativeTargetAsmPrinter();
    module = new llvm::Module("liquid", llvmContext);
+   // The layout is needed while code generation (e.g. size of a list), not only when the code is run.
+   // The host CPU is selected, so the optimizer knows the vector width and the JIT uses the same instructions.
+   targetMachine.reset(EngineBuilder().setMCPU(sys::getHostCPUName()).selectTarget());
+   module->setTargetTriple(targetMachine->getTargetTriple().str());
+   module->setDataLayout(targetMachine->createDataLayout());
 }
 
-#define MAKE_LLVM_EXTERNAL_NAME(a) #a
+namespace
+{
+/*! What a built in function does besides returning a value, the optimizer uses it to remove, combine or move calls. */
+enum class BuiltinEffect {
+   ReadArgs,        ///< Only reads the memory the pointer arguments point to.
+   Read,            ///< Only reads memory, also the one reachable from the pointer arguments.
+   WriteArgs,       ///< Only reads and writes the memory the pointer arguments point to.
+   WriteArgsOrStop, ///< Like WriteArgs, but may stop the script with a runtime error.
+   Allocate,        ///< Returns new memory, the pointer arguments are only read.
+   AllocateOrShare, ///< Like Allocate, but may return a pointer argument instead of new memory.
+   Free,            ///< Releases the memory returned by an Allocate function.
+   Any,             ///< Anything else, like writing the output.
+};
+
+/*! A built in function.
+ * The types of the result and the parameters are given by one character:
+ * i int, d double, s string, p pointer, v void and . for variable arguments.
+ */
+struct Builtin
+{
+   const char*   name;
+   char          result;
+   const char*   params;
+   void*         addr;
+   BuiltinEffect effect;
+};
+
+// clang-format off
+const Builtin builtinFunctions[] = {
+   {"printvalue",           'i', "i",     (void*)printvalue,           BuiltinEffect::Any},
+   {"printdouble",          'd', "d",     (void*)printdouble,          BuiltinEffect::Any},
+   {"display",              'v', "s.",    (void*)display,              BuiltinEffect::Any},
+   {"displayln",            'v', "s.",    (void*)displayln,            BuiltinEffect::Any},
+   {"flush",                'v', "",      (void*)liq_flush,            BuiltinEffect::Any},
+   {"liq_write_lit",        'v', "si",    (void*)liq_write_lit,        BuiltinEffect::Any},
+   {"liq_write_str",        'v', "s",     (void*)liq_write_str,        BuiltinEffect::Any},
+   {"liq_write_i64",        'v', "i",     (void*)liq_write_i64,        BuiltinEffect::Any},
+   {"liq_write_f64",        'v', "d",     (void*)liq_write_f64,        BuiltinEffect::Any},
+   {"liq_write_fmt_i64",    'v', "si",    (void*)liq_write_fmt_i64,    BuiltinEffect::Any},
+   {"liq_write_fmt_f64",    'v', "sd",    (void*)liq_write_fmt_f64,    BuiltinEffect::Any},
+   {"liq_write_fmt_str",    'v', "ss",    (void*)liq_write_fmt_str,    BuiltinEffect::Any},
+   {"liq_array_alloc",      'p', "ii",    (void*)liq_array_alloc,      BuiltinEffect::Allocate},
+   {"liq_array_free",       'v', "p",     (void*)liq_array_free,       BuiltinEffect::Free},
+   {"liq_sum_i64",          'i', "pi",    (void*)liq_sum_i64,          BuiltinEffect::ReadArgs},
+   {"liq_sum_f64",          'd', "pi",    (void*)liq_sum_f64,          BuiltinEffect::ReadArgs},
+   {"liq_min_i64",          'i', "pi",    (void*)liq_min_i64,          BuiltinEffect::ReadArgs},
+   {"liq_min_f64",          'd', "pi",    (void*)liq_min_f64,          BuiltinEffect::ReadArgs},
+   {"liq_max_i64",          'i', "pi",    (void*)liq_max_i64,          BuiltinEffect::ReadArgs},
+   {"liq_max_f64",          'd', "pi",    (void*)liq_max_f64,          BuiltinEffect::ReadArgs},
+   {"liq_dot_i64",          'i', "ppi",   (void*)liq_dot_i64,          BuiltinEffect::ReadArgs},
+   {"liq_dot_f64",          'd', "ppi",   (void*)liq_dot_f64,          BuiltinEffect::ReadArgs},
+   {"liq_axpy_i64",         'v', "pippi", (void*)liq_axpy_i64,         BuiltinEffect::WriteArgs},
+   {"liq_axpy_f64",         'v', "pdppi", (void*)liq_axpy_f64,         BuiltinEffect::WriteArgs},
+   {"liq_scale_i64",        'v', "pipi",  (void*)liq_scale_i64,        BuiltinEffect::WriteArgs},
+   {"liq_scale_f64",        'v', "pdpi",  (void*)liq_scale_f64,        BuiltinEffect::WriteArgs},
+   {"liq_add_i64",          'v', "pppi",  (void*)liq_add_i64,          BuiltinEffect::WriteArgs},
+   {"liq_sub_i64",          'v', "pppi",  (void*)liq_sub_i64,          BuiltinEffect::WriteArgs},
+   {"liq_mul_i64",          'v', "pppi",  (void*)liq_mul_i64,          BuiltinEffect::WriteArgs},
+   {"liq_div_i64",          'v', "pppi",  (void*)liq_div_i64,          BuiltinEffect::WriteArgsOrStop},
+   {"liq_add_f64",          'v', "pppi",  (void*)liq_add_f64,          BuiltinEffect::WriteArgs},
+   {"liq_sub_f64",          'v', "pppi",  (void*)liq_sub_f64,          BuiltinEffect::WriteArgs},
+   {"liq_mul_f64",          'v', "pppi",  (void*)liq_mul_f64,          BuiltinEffect::WriteArgs},
+   {"liq_div_f64",          'v', "pppi",  (void*)liq_div_f64,          BuiltinEffect::WriteArgs},
+   {"liq_fill_i64",         'v', "pii",   (void*)liq_fill_i64,         BuiltinEffect::WriteArgs},
+   {"liq_fill_f64",         'v', "pdi",   (void*)liq_fill_f64,         BuiltinEffect::WriteArgs},
+   {"liq_cvt_i64_f64",      'v', "ppi",   (void*)liq_cvt_i64_f64,      BuiltinEffect::WriteArgs},
+   {"liq_str_alloc",        's', "i",     (void*)liq_str_alloc,        BuiltinEffect::Allocate},
+   {"liq_str_concat",       's', "ss",    (void*)liq_str_concat,       BuiltinEffect::Allocate},
+   {"liq_str_compare",      'i', "ss",    (void*)liq_str_compare,      BuiltinEffect::ReadArgs},
+   {"liq_str_equal",        'i', "ss",    (void*)liq_str_equal,        BuiltinEffect::ReadArgs},
+   {"liq_str_hash",         'i', "s",     (void*)liq_str_hash,         BuiltinEffect::ReadArgs},
+   {"liq_str_substr",       's', "sii",   (void*)liq_str_substr,       BuiltinEffect::AllocateOrShare},
+   {"liq_map_new_i64",      'p', "",      (void*)liq_map_new_i64,      BuiltinEffect::Allocate},
+   {"liq_map_new_f64",      'p', "",      (void*)liq_map_new_f64,      BuiltinEffect::Allocate},
+   {"liq_map_new_str",      'p', "",      (void*)liq_map_new_str,      BuiltinEffect::Allocate},
+   {"liq_map_free_i64",     'v', "p",     (void*)liq_map_free_i64,     BuiltinEffect::Any},
+   {"liq_map_free_f64",     'v', "p",     (void*)liq_map_free_f64,     BuiltinEffect::Any},
+   {"liq_map_free_str",     'v', "p",     (void*)liq_map_free_str,     BuiltinEffect::Any},
+   {"liq_map_len",          'i', "p",     (void*)liq_map_len,          BuiltinEffect::ReadArgs},
+   {"liq_map_get_i64",      'i', "pii",   (void*)liq_map_get_i64,      BuiltinEffect::Read},
+   {"liq_map_get_f64",      'i', "pdi",   (void*)liq_map_get_f64,      BuiltinEffect::Read},
+   {"liq_map_get_str",      'i', "psi",   (void*)liq_map_get_str,      BuiltinEffect::Read},
+   {"liq_map_contains_i64", 'i', "pi",    (void*)liq_map_contains_i64, BuiltinEffect::Read},
+   {"liq_map_contains_f64", 'i', "pd",    (void*)liq_map_contains_f64, BuiltinEffect::Read},
+   {"liq_map_contains_str", 'i', "ps",    (void*)liq_map_contains_str, BuiltinEffect::Read},
+   // Both may allocate or free the slots.
+   {"liq_map_put_i64",      'v', "pii",   (void*)liq_map_put_i64,      BuiltinEffect::Any},
+   {"liq_map_put_f64",      'v', "pdi",   (void*)liq_map_put_f64,      BuiltinEffect::Any},
+   {"liq_map_put_str",      'v', "psi",   (void*)liq_map_put_str,      BuiltinEffect::Any},
+   {"liq_map_remove_i64",   'i', "pi",    (void*)liq_map_remove_i64,   BuiltinEffect::Any},
+   {"liq_map_remove_f64",   'i', "pd",    (void*)liq_map_remove_f64,   BuiltinEffect::Any},
+   {"liq_map_remove_str",   'i', "ps",    (void*)liq_map_remove_str,   BuiltinEffect::Any},
+   {"liq_pool_alloc",       'p', "i",     (void*)liq_pool_alloc,       BuiltinEffect::Allocate},
+   {"liq_soa_new",          'p', "i",     (void*)liq_soa_new,          BuiltinEffect::Allocate},
+   // Moves the columns, which are reachable from the table.
+   {"liq_soa_append",       'i', "p",     (void*)liq_soa_append,       BuiltinEffect::Any},
+   {"liq_soa_free",         'v', "p",     (void*)liq_soa_free,         BuiltinEffect::Any},
+   {"liq_tier_up",          'v', "i",     (void*)liq_tier_up,          BuiltinEffect::Any},
+};
+// clang-format on
+
+using MathFunction = double (*)(double);
+
+///< The C library functions, the math intrinsics may be lowered to. They are only mapped, not declared.
+const std::pair<const char*, void*> libmFunctions[] = {
+   {"sin", (void*)static_cast<MathFunction>(std::sin)},
+   {"cos", (void*)static_cast<MathFunction>(std::cos)},
+   {"exp", (void*)static_cast<MathFunction>(std::exp)},
+   {"log", (void*)static_cast<MathFunction>(std::log)},
+   {"floor", (void*)static_cast<MathFunction>(std::floor)},
+   {"ceil", (void*)static_cast<MathFunction>(std::ceil)},
+   {"pow", (void*)static_cast<double (*)(double, double)>(std::pow)},
+   {"fma", (void*)static_cast<double (*)(double, double, double)>(std::fma)},
+};
+} // namespace
+
 void CodeGenContext::setupBuiltIns()
 {
    intType = getGenericIntegerType();
@@ -68,44 +203,84 @@ void CodeGenContext::setupBuiltIns()
    llvmTypeMap["void"] = voidType;
    llvmTypeMap["var"] = varType;
 
-   std::vector<Type*>     argTypesOneInt(1, intType);
-   FunctionType*          ft = FunctionType::get(intType, argTypesOneInt, false);
-   Function*              f  = Function::Create(ft, Function::ExternalLinkage, MAKE_LLVM_EXTERNAL_NAME(printvalue), getModule());
-   Function::arg_iterator i  = f->arg_begin();
-   if (i != f->arg_end())
-      i->setName("val");
-   builtins.push_back({f, (void*)printvalue});
-
-   std::vector<Type*> argTypesOneDouble(1, Type::getDoubleTy(getGlobalContext()));
-   ft = FunctionType::get(Type::getDoubleTy(getGlobalContext()), argTypesOneDouble, false);
-   f  = Function::Create(ft, Function::ExternalLinkage, MAKE_LLVM_EXTERNAL_NAME(printdouble), getModule());
-   i  = f->arg_begin();
-   if (i != f->arg_end())
-      i->setName("val");
-   builtins.push_back({f, (void*)printdouble});
-
-    ft = FunctionType::get(Type::getDoubleTy(getGlobalContext()), argTypesOneDouble,false);
-    f = Function::Create( ft, Function::ExternalLinkage, MAKE_LLVM_EXTERNAL_NAME(sin),getModule());
-    i = f->arg_begin();
-    if( i != f->arg_end() )
-       i->setName("val");
-   builtins.push_back({f, (void*)sinus});
-
-   std::vector<Type*> argTypesInt8Ptr(1, stringType);
-   ft = FunctionType::get(Type::getVoidTy(getGlobalContext()), argTypesInt8Ptr, true);
-   f  = Function::Create(ft, Function::ExternalLinkage, MAKE_LLVM_EXTERNAL_NAME(display), getModule());
-   i  = f->arg_begin();
-   if (i != f->arg_end())
-      i->setName("format_str");
-   builtins.push_back({f, (void*)display});
-
-   ft = FunctionType::get(Type::getVoidTy(getGlobalContext()), argTypesInt8Ptr, true);
-   f  = Function::Create(ft, Function::ExternalLinkage, MAKE_LLVM_EXTERNAL_NAME(displayln), getModule());
-   i  = f->arg_begin();
-   if (i != f->arg_end())
-      i->setName("format_str");
-   builtins.push_back({f, (void*)displayln});
+   // Typed arrays are passed by value as {data, len}, the storage is on the heap.
+   auto ptrType = PointerType::getUnqual(getGlobalContext());
+   intArrayType    = StructType::create(getGlobalContext(), {ptrType, intType}, "array.int");
+   doubleArrayType = StructType::create(getGlobalContext(), {ptrType, intType}, "array.double");
+   llvmTypeMap["int[]"]    = intArrayType;
+   llvmTypeMap["double[]"] = doubleArrayType;
 
+   auto typeOfCode = [&](char code) -> Type* {
+      switch( code ) {
+         case 'i': return intType;
+         case 'd': return doubleType;
+         case 's': return stringType;
+         case 'p': return ptrType;
+         default: return voidType;
+      }
+   };
+   for( auto& builtin : builtinFunctions ) {
+      std::vector<Type*> params;
+      bool               isVarArg = false;
+      for( auto code = builtin.params; *code != '\0'; ++code ) {
+         if( *code == '.' ) {
+            isVarArg = true;
+         } else {
+            params.push_back(typeOfCode(*code));
+         }
+      }
+      auto fty = FunctionType::get(typeOfCode(builtin.result), params, isVarArg);
+      auto fn  = Function::Create(fty, Function::ExternalLinkage, builtin.name, getModule());
+      fn->setDoesNotThrow();
+      if( builtin.effect != BuiltinEffect::Any && builtin.effect != BuiltinEffect::WriteArgsOrStop ) {
+         fn->setWillReturn();
+      }
+      if( builtin.effect != BuiltinEffect::Any && builtin.effect != BuiltinEffect::AllocateOrShare ) {
+         for( auto& arg : fn->args() ) {
+            if( arg.getType()->isPointerTy() ) {
+               fn->addParamAttr(arg.getArgNo(), Attribute::NoCapture);
+            }
+         }
+      }
+      switch( builtin.effect ) {
+         case BuiltinEffect::ReadArgs:
+            fn->setOnlyAccessesArgMemory();
+            fn->setOnlyReadsMemory();
+            break;
+         case BuiltinEffect::Read:
+            fn->setOnlyReadsMemory();
+            break;
+         case BuiltinEffect::WriteArgs:
+         case BuiltinEffect::WriteArgsOrStop:
+            fn->setOnlyAccessesArgMemory();
+            break;
+         case BuiltinEffect::Allocate:
+         case BuiltinEffect::AllocateOrShare:
+            fn->setOnlyAccessesInaccessibleMemOrArgMem();
+            if( builtin.effect == BuiltinEffect::Allocate ) {
+               fn->addRetAttr(Attribute::NoAlias);
+            }
+            for( auto& arg : fn->args() ) {
+               if( arg.getType()->isPointerTy() ) {
+                  fn->addParamAttr(arg.getArgNo(), Attribute::ReadOnly);
+               }
+            }
+            break;
+         case BuiltinEffect::Free:
+            fn->setOnlyAccessesInaccessibleMemOrArgMem();
+            break;
+         case BuiltinEffect::Any:
+            break;
+      }
+      if( builtin.result == 's' ) {
+         setLiquidType(fn, "string");
+      }
+      addCallTarget(builtin.name, "", fn);
+      builtins.push_back({builtin.name, builtin.addr});
+   }
+   for( auto& function : libmFunctions ) {
+      builtins.push_back({function.first, function.second});
+   }
 }
 
 bool CodeGenContext::generateCode(Block& root)
@@ -115,7 +290,8 @@ bool CodeGenContext::generateCode(Block& root)
    /* Create the top level interpreter function to call as entry */
    vector<Type*> argTypes;
    FunctionType* ftype = FunctionType::get(Type::getVoidTy(getGlobalContext()), argTypes, false);
-   mainFunction        = Function::Create(ftype, GlobalValue::InternalLinkage, "main", getModule());
+   // External linkage, otherwise the optimizer removes main as unused.
+   mainFunction        = Function::Create(ftype, GlobalValue::ExternalLinkage, "main", getModule());
    BasicBlock* bblock  = BasicBlock::Create(getGlobalContext(), "entry", mainFunction, 0);
    setupBuiltIns();
    /* Push a new variable/block context */
@@ -131,22 +307,40 @@ bool CodeGenContext::generateCode(Block& root)
    if (currentBlock()->getTerminator() == nullptr) {
       ReturnInst::Create(getGlobalContext(), 0, currentBlock());
    }
+   freeTables(*mainFunction);
+   freeArrays(*mainFunction);
    endScope();
 
    outs << "Code is generated.\n";
 
-   outs << "verifying... ";
-   llvm::raw_os_ostream rawouts(outs);
-   if (verifyModule(*getModule(), &rawouts)) {
-      outs << ": Error constructing function!\n";
+   latencyMode = isLatencyMode();
+#if defined(_DEBUG)
+   bool verify = true;
+#else
+   // The verifier takes longer than a short script runs.
+   bool verify = !latencyMode;
+#endif
+   if (verify) {
+      outs << "verifying... ";
+      llvm::raw_os_ostream rawouts(outs);
+      if (verifyModule(*getModule(), &rawouts)) {
+         outs << ": Error constructing function!\n";
 #if !defined(LLVM_NO_DUMP)
-      module->dump();
+         module->dump();
 #endif
-      return false;
+         return false;
+      }
+      outs << "done.\n";
    }
-   outs << "done.\n";
 
-   if (!debug) {
+   if (compileMode == CompileMode::Tiered) {
+      outs << "Compile tiered.\n";
+      tiered = std::make_unique<TieredCompiler>(*this);
+      tiered->prepare(*getModule());
+   } else if (latencyMode) {
+      outs << "Compile for latency.\n";
+   } else if (!debug) {
+      linkRuntime(*getModule(), outs);
       optimize();
    }
 #if !defined(LLVM_NO_DUMP) // Only the debug build of LLVM has a dump() method.
@@ -161,44 +355,237 @@ bool CodeGenContext::generateCode(Block& root)
 
 GenericValue CodeGenContext::runCode()
 {
-   outs << "Running code...\n";
-   std::string      err;
-   ExecutionEngine* ee = EngineBuilder(std::unique_ptr<Module>(module)).setErrorStr(&err).setEngineKind(EngineKind::JIT).create();
-   assert(ee);
-   for (auto info : builtins) {
-      ee->addGlobalMapping(info.f, info.addr);
+   outs << "Running code..." << std::endl;
+   std::string   err;
+   EngineBuilder builder{std::unique_ptr<Module>(module)};
+   builder.setErrorStr(&err).setEngineKind(EngineKind::JIT).setMCPU(sys::getHostCPUName());
+   if (latencyMode) {
+      // FastISel selects the instructions in one pass and the fast register allocator is used.
+      TargetOptions options;
+      options.EnableFastISel = true;
+      builder.setOptLevel(CodeGenOptLevel::None).setTargetOptions(options);
    }
+   ExecutionEngine* ee = builder.create();
+   assert(ee);
+   mapBuiltins(*ee);
 
    ee->finalizeObject();
+   if (tiered) {
+      tiered->start(*ee);
+   }
    vector<GenericValue> noargs;
    GenericValue         v = ee->runFunction(mainFunction, noargs);
+   if (tiered) {
+      outs << "Optimized functions: " << tiered->stop() << "\n";
+      for (auto& message : tiered->getDiagnostics()) {
+         std::cerr << message;
+      }
+   }
+   liq_flush();
+   // The objects and strings have no owner, so they all are released when the script is done.
+   liq_pool_release();
+   liq_str_release();
    outs << "Code was run.\n";
+   // The optimized code calls into the module of the engine.
+   tiered.reset();
    delete ee;
    return v;
 }
 
+void CodeGenContext::mapBuiltins(ExecutionEngine& engine)
+{
+   // Map by name, the optimizer has removed the declarations of unused built ins.
+   for (auto& info : builtins) {
+      engine.addGlobalMapping(info.name, reinterpret_cast<uint64_t>(info.addr));
+   }
+}
+
 void CodeGenContext::printCodeGeneration(class Block& root, std::ostream& outstream)
 {
    VisitorPrettyPrint visitor(outstream);
    root.Accept(visitor);
 }
 
+void CodeGenContext::linkRuntime(llvm::Module& m, std::ostream& log)
+{
+   if (liqRuntimeBitcodeSize == 0) {
+      return;
+   }
+   StringRef bitcode(reinterpret_cast<const char*>(liqRuntimeBitcode), liqRuntimeBitcodeSize);
+   auto      runtime = parseBitcodeFile(MemoryBufferRef(bitcode, "runtime"), m.getContext());
+   if (!runtime) {
+      log << "Runtime bitcode not linked: " << toString(runtime.takeError()) << "\n";
+      return;
+   }
+   // Only the used built ins are linked, an unused declaration would pull in its definition.
+   for (auto& fn : make_early_inc_range(m)) {
+      if (fn.isDeclaration() && fn.use_empty()) {
+         fn.eraseFromParent();
+      }
+   }
+   (*runtime)->setTargetTriple(m.getTargetTriple());
+   (*runtime)->setDataLayout(m.getDataLayout());
+   auto internalize = [](Module& m, const StringSet<>& linked) {
+      internalizeModule(m, [&linked](const GlobalValue& gv) { return !gv.hasName() || linked.count(gv.getName()) == 0; });
+   };
+   if (Linker::linkModules(m, std::move(*runtime), Linker::Flags::LinkOnlyNeeded, internalize)) {
+      log << "Runtime bitcode not linked.\n";
+      return;
+   }
+   for (auto& fn : m) {
+      // The runtime is compiled for a generic CPU, the code of the script for the host.
+      fn.removeFnAttr("target-cpu");
+      fn.removeFnAttr("target-features");
+      fn.removeFnAttr("tune-cpu");
+   }
+}
+
+namespace
+{
+/*! Returns true, if the pointer to a new object may be used after the function returned.
+ * That is if it is stored, returned or passed to a function, which keeps it or is tail called.
+ * An object allocated in a loop also escapes into the next iteration, if it is merged by a phi or select.
+ */
+bool objectEscapes(Value* object, bool inLoop)
+{
+   SmallVector<Value*, 8> pointers{object};
+   SmallPtrSet<Value*, 8> visited{object};
+   while (!pointers.empty()) {
+      auto pointer = pointers.pop_back_val();
+      for (auto& use : pointer->uses()) {
+         auto user = use.getUser();
+         if (isa<LoadInst>(user) || isa<ICmpInst>(user)) {
+            continue;
+         }
+         if (auto store = dyn_cast<StoreInst>(user)) {
+            if (store->getValueOperand() == pointer) {
+               return true;
+            }
+            continue;
+         }
+         if (inLoop && (isa<PHINode>(user) || isa<SelectInst>(user))) {
+            return true;
+         }
+         if (isa<GetElementPtrInst>(user) || isa<PHINode>(user) || isa<SelectInst>(user) || isa<BitCastInst>(user)) {
+            // Another pointer into the object.
+            if (visited.insert(user).second) {
+               pointers.push_back(user);
+            }
+            continue;
+         }
+         auto call = dyn_cast<CallBase>(user);
+         if (call != nullptr && call->isArgOperand(&use) && call->doesNotCapture(call->getArgOperandNo(&use)) && !call->isMustTailCall()) {
+            continue;
+         }
+         return true;
+      }
+   }
+   return false;
+}
+
+/*! Moves the objects of the pool onto the stack, which don't leave the function.
+ * It runs after the inlining, so the methods called on a local object are mostly part of the function.
+ * The stack slot of an object allocated in a loop is reused by every iteration.
+ */
+struct ObjectToStackPass : PassInfoMixin<ObjectToStackPass>
+{
+   PreservedAnalyses run(Function& fn, FunctionAnalysisManager& fam)
+   {
+      auto&                     loops = fam.getResult<LoopAnalysis>(fn);
+      SmallVector<CallInst*, 8> objects;
+      for (auto& inst : instructions(fn)) {
+         auto call = dyn_cast<CallInst>(&inst);
+         if (call == nullptr || call->getCalledFunction() == nullptr || call->getCalledFunction()->getName() != "liq_pool_alloc") {
+            continue;
+         }
+         if (isa<ConstantInt>(call->getArgOperand(0)) && !objectEscapes(call, loops.getLoopFor(call->getParent()) != nullptr)) {
+            objects.push_back(call);
+         }
+      }
+      if (objects.empty()) {
+         return PreservedAnalyses::all();
+      }
+      auto& entry = fn.getEntryBlock();
+      for (auto call : objects) {
+         // The insertion point is taken anew, it may have been one of the erased calls.
+         IRBuilder<> builder(&entry, entry.getFirstInsertionPt());
+         auto        size   = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue();
+         auto        object = builder.CreateAlloca(ArrayType::get(builder.getInt8Ty(), size), nullptr, "object");
+         object->setAlignment(Align(16)); // as the objects of the pool
+         call->replaceAllUsesWith(object);
+         call->eraseFromParent();
+      }
+      // A tail call must not get a pointer into the stack of the caller.
+      for (auto& inst : instructions(fn)) {
+         auto call = dyn_cast<CallInst>(&inst);
+         if (call == nullptr || !call->isTailCall() || call->isMustTailCall()) {
+            continue;
+         }
+         for (auto& arg : call->args()) {
+            if (isa<AllocaInst>(getUnderlyingObject(arg))) {
+               call->setTailCall(false);
+               break;
+            }
+         }
+      }
+      PreservedAnalyses preserved;
+      preserved.preserveSet<CFGAnalyses>();
+      return preserved;
+   }
+};
+} // namespace
+
 void CodeGenContext::optimize()
 {
    outs << "Optimize code...\n";
+   optimize(*getModule(), *targetMachine, std::cerr);
+}
+
+void CodeGenContext::optimize(llvm::Module& m, llvm::TargetMachine& tm, std::ostream& log)
+{
    LoopAnalysisManager LAM;
    FunctionAnalysisManager FAM;
    CGSCCAnalysisManager CGAM;
    ModuleAnalysisManager MAM;
-   PassBuilder PB;
+   PassBuilder PB(&tm);
+   TargetLibraryInfoImpl TLII(tm.getTargetTriple());
+   if (!vectorLibrary.empty()) {
+      addVectorLibrary(TLII, log);
+   }
+   // Has to be registered before the default analyses.
+   FAM.registerPass([&] { return TargetLibraryAnalysis(TLII); });
    PB.registerModuleAnalyses(MAM);
    PB.registerCGSCCAnalyses(CGAM);
    PB.registerFunctionAnalyses(FAM);
    PB.registerLoopAnalyses(LAM);
    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+   PB.registerScalarOptimizerLateEPCallback([](FunctionPassManager& fpm, OptimizationLevel) {
+      fpm.addPass(ObjectToStackPass());
+      // Splits the objects moved onto the stack into registers.
+      fpm.addPass(SROAPass(SROAOptions::ModifyCFG));
+   });
    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
    // Optimize the IR!
-   MPM.run(*getModule(), MAM);
+   MPM.run(m, MAM);
+}
+
+void CodeGenContext::addVectorLibrary(TargetLibraryInfoImpl& tlii, std::ostream& log)
+{
+   if (vectorLibrary != "libmvec") {
+      log << "Unknown vector library " << vectorLibrary << " ignored.\n";
+      return;
+   }
+   // The vector variants are called by the JIT code, so the library has to be in the process.
+   std::string err;
+   if (sys::DynamicLibrary::LoadLibraryPermanently("libmvec.so.1", &err)) {
+      log << "libmvec not loaded: " << err << "\n";
+      return;
+   }
+#if LLVM_VERSION_MAJOR >= 21
+   tlii.addVectorizableFunctionsFromVecLib(TargetLibraryInfoImpl::LIBMVEC, targetMachine->getTargetTriple());
+#else
+   tlii.addVectorizableFunctionsFromVecLib(TargetLibraryInfoImpl::LIBMVEC_X86, targetMachine->getTargetTriple());
+#endif
 }
 
 void CodeGenContext::newScope(BasicBlock* bb, ScopeType scopeType)
@@ -235,6 +622,10 @@ AllocaInst* CodeGenContext::findVariable(std::string varName)
       if (names.find(varName) != names.end()) {
          return names[varName];
       }
+      if (cb->getImmutables().count(varName) != 0) {
+         // An immutable of an inner scope hides the variables of the same name outside, see findImmutable.
+         return nullptr;
+      }
    }
 
    // If we are in a class then check the calls variables, too.
@@ -247,6 +638,29 @@ AllocaInst* CodeGenContext::findVariable(std::string varName)
    return nullptr;
 }
 
+bool CodeGenContext::isImmutableScalar(const VariableDeclaration& declaration, llvm::Type* type)
+{
+   return (type == intType || type == doubleType || type == boolType) && !declaration.isAssigned();
+}
+
+llvm::Value* CodeGenContext::findImmutable(const std::string& varName)
+{
+   // The same scopes as findVariable, an immutable is never an instance variable.
+   if (currentScopeType == ScopeType::FunctionDeclaration) {
+      auto& values = codeBlocks.front()->getImmutables();
+      auto  found  = values.find(varName);
+      return found != values.end() ? found->second : nullptr;
+   }
+   for (auto& cb : codeBlocks) {
+      auto& values = cb->getImmutables();
+      auto  found  = values.find(varName);
+      if (found != values.end()) {
+         return found->second;
+      }
+   }
+   return nullptr;
+}
+
 void CodeGenContext::deleteVariable(std::string varName)
 {
    ValueNames& names   = locals();
@@ -301,13 +715,18 @@ Instruction* CodeGenContext::getKlassVarAccessInst(std::string klass, std::strin
    ptr_indices.push_back(const_int32);
    auto structTy = classTypeMap[klass];
    auto valType = std::get<1>(classAttributes[klass][name]);
+   Instruction* ptr = nullptr;
    if (this_ptr->getAllocatedType()->isPointerTy()) {
       // since the alloc is a ptr to ptr
       auto klassPtr = new LoadInst(this_ptr->getType(), this_ptr, "load.this", currentBlock());
-      auto instr = GetElementPtrInst::Create(structTy, klassPtr, ptr_indices, "", currentBlock());
-      return instr;
+      ptr = GetElementPtrInst::Create(structTy, klassPtr, ptr_indices, "", currentBlock());
+   } else {
+      ptr = GetElementPtrInst::Create(structTy, this_ptr, ptr_indices, "", currentBlock());
+   }
+   if (valType->isPointerTy()) {
+      // The only instance variables, which are pointers, are strings (see Assignment::checkMemberValue).
+      setLiquidType(ptr, "string");
    }
-   Instruction* ptr = GetElementPtrInst::Create(structTy, this_ptr, ptr_indices, "", currentBlock());
    return ptr;
 }
 
@@ -332,6 +751,19 @@ Type* CodeGenContext::typeOf(const std::string& name)
    if( llvmTypeMap.count(name) != 0 ) {
       return llvmTypeMap[name];
    }
+   if( name.compare(0, 4, "map<") == 0 && name.back() == '>' && name.find(',') != std::string::npos ) {
+      auto comma   = name.find(',');
+      auto mapType = getMapType(name.substr(4, comma - 4), name.substr(comma + 1, name.size() - comma - 2));
+      if( mapType != nullptr ) {
+         return mapType;
+      }
+   }
+   if( name.compare(0, 4, "soa<") == 0 && name.back() == '>' ) {
+      auto soaType = getSoaType(name.substr(4, name.size() - 5));
+      if( soaType != nullptr ) {
+         return soaType;
+      }
+   }
 
    llvm::Type* ty = StructType::getTypeByName(getModule()->getContext(), "class." + name);
    if (ty != nullptr) {
@@ -351,12 +783,22 @@ std::string CodeGenContext::typeNameOf(llvm::Type* type)
          return "int";
       case llvm::Type::TypeID::VoidTyID:
          return "void";
+      case llvm::Type::TypeID::StructTyID:
+         if( type == intArrayType )
+            return "int[]";
+         if( type == doubleArrayType )
+            return "double[]";
+         if( isMapType(type) || isSoaType(type) ) {
+            auto found = std::find_if(std::begin(llvmTypeMap), std::end(llvmTypeMap), [&](auto kv) { return kv.second == type; });
+            return found->first;
+         }
+         return "void";
       default:
          return "void";
    }
 }
 
-void CodeGenContext::addKlassInitCode(std::string name, Assignment* assign) { classInitCode[name].insert(assign); }
+void CodeGenContext::addKlassInitCode(std::string name, Assignment* assign) { classInitCode[name].push_back(assign); }
 
 KlassInitCodeAssign& CodeGenContext::getKlassInitCode(std::string name) { return classInitCode[name]; }
 
@@ -369,6 +811,47 @@ std::string CodeGenContext::findClassNameByType(llvm::Type* ty)
    return "";
 }
 
+llvm::Value* CodeGenContext::createObject(llvm::Type* klassType)
+{
+   auto size   = getModule()->getDataLayout().getTypeAllocSize(klassType);
+   auto object = callBuiltin("liq_pool_alloc", {ConstantInt::get(intType, size)});
+   setLiquidType(object, findClassNameByType(klassType));
+   return object;
+}
+
+void CodeGenContext::setLiquidType(llvm::Value* value, const std::string& typeName)
+{
+   if (value != nullptr && !typeName.empty()) {
+      liquidTypes[value] = typeName;
+   }
+}
+
+std::string CodeGenContext::getLiquidType(llvm::Value* value)
+{
+   auto found = liquidTypes.find(value);
+   if (found != liquidTypes.end()) {
+      return found->second;
+   }
+   if (auto load = dyn_cast<LoadInst>(value)) {
+      found = liquidTypes.find(load->getPointerOperand());
+   } else if (auto call = dyn_cast<CallInst>(value)) {
+      found = liquidTypes.find(call->getCalledFunction());
+   }
+   return found != liquidTypes.end() ? found->second : "";
+}
+
+std::string CodeGenContext::getListElementType(llvm::Value* list, unsigned index)
+{
+   auto found = listElementTypes.find(list);
+   return found != listElementTypes.end() && index < found->second.size() ? found->second[index] : "";
+}
+
+std::string CodeGenContext::getObjectClassName(llvm::Value* object)
+{
+   auto typeName = getLiquidType(object);
+   return isClass(typeName) ? typeName : "";
+}
+
 llvm::Type* CodeGenContext::getGenericIntegerType()
 {
 #if defined(UseInt64)
@@ -382,9 +865,35 @@ bool CodeGenContext::preProcessing(Block& root)
 {
    VisitorSyntaxCheck visitor;
    root.Accept(visitor);
+   VisitorAssignedVariables assigned;
+   root.Accept(assigned);
    return !visitor.hasErrors();
 }
 
+bool CodeGenContext::isLatencyMode()
+{
+   if( compileMode != CompileMode::Auto ) {
+      // Tiered starts with the unoptimized code too.
+      return compileMode != CompileMode::Throughput;
+   }
+   // A small script without loops and recursion runs shorter than the optimizer would take.
+   constexpr unsigned maxInstructions = 1000;
+   if( loopCount != 0 ) {
+      return false;
+   }
+   unsigned count = 0;
+   for( auto& function : *module ) {
+      for( auto& inst : instructions(function) ) {
+         auto call = dyn_cast<CallInst>(&inst);
+         if( call != nullptr && call->getCalledFunction() == &function ) {
+            return false;
+         }
+         ++count;
+      }
+   }
+   return count < maxInstructions;
+}
+
 FunctionDeclaration* CodeGenContext::getTemplateFunction(const std::string& name)
 {
    if( templatedFunctionDeclarations.count(name) > 0 ) {
@@ -392,6 +901,23 @@ FunctionDeclaration* CodeGenContext::getTemplateFunction(const std::string& name
    }
    return nullptr;
 }
+
+void CodeGenContext::addCallTarget(const std::string& name, const std::string& klass, llvm::Function* function)
+{
+   auto   ftype = function->getFunctionType();
+   size_t arity = ftype->isVarArg() ? CallTarget::variadic : ftype->getNumParams() - (klass.empty() ? 0 : 1);
+   callTargets[{name, klass, arity}] = function;
+}
+
+llvm::Function* CodeGenContext::findCallTarget(const std::string& name, const std::string& klass, size_t arity)
+{
+   auto found = callTargets.find({name, klass, arity});
+   if (found == std::end(callTargets)) {
+      // Only a function with variable arguments takes a second look.
+      found = callTargets.find({name, klass, CallTarget::variadic});
+   }
+   return found != std::end(callTargets) ? found->second : nullptr;
+}
    llvm::Type* CodeGenContext::getType(Identifier const& ident)
    {
       if( ident.getStructName() == "self" ) {
@@ -407,4 +933,965 @@ FunctionDeclaration* CodeGenContext::getTemplateFunction(const std::string& name
       return classAttributes[klassName][memberName].second;
    }
 
+llvm::Align CodeGenContext::getKlassMemberAlign(std::string const& klassName, std::string const& memberName)
+{
+   return getFieldAlign(cast<StructType>(classTypeMap[klassName]), classAttributes[klassName][memberName].first);
+}
+
+llvm::Align CodeGenContext::getFieldAlign(llvm::StructType* klassType, unsigned index)
+{
+   auto& dataLayout = getModule()->getDataLayout();
+   auto  align      = dataLayout.getABITypeAlign(klassType->getElementType(index));
+   if( !klassType->isPacked() ) {
+      return align;
+   }
+   // The objects are aligned to 16 bytes (liq_pool_alloc and the objects moved to the stack), a field of a packed
+   // object is aligned as far as its offset allows.
+   auto offset = dataLayout.getStructLayout(klassType)->getElementOffset(index);
+   return std::min(align, commonAlignment(Align(16), offset));
+}
+
+llvm::Type* CodeGenContext::getArrayType(llvm::Type* elementType)
+{
+   if( elementType == intType ) {
+      return intArrayType;
+   }
+   if( elementType == doubleType ) {
+      return doubleArrayType;
+   }
+   return nullptr;
+}
+
+llvm::Type* CodeGenContext::getArrayElementType(llvm::Type* arrayType)
+{
+   if( arrayType == intArrayType ) {
+      return intType;
+   }
+   if( arrayType == doubleArrayType ) {
+      return doubleType;
+   }
+   return nullptr;
+}
+
+llvm::CallInst* CodeGenContext::callBuiltin(const std::string& name, std::vector<llvm::Value*> args)
+{
+   Function* fn = getModule()->getFunction(name);
+   assert(fn != nullptr);
+   return CallInst::Create(fn, args, "", currentBlock());
+}
+
+const LoopTargets* CodeGenContext::currentLoop()
+{
+   // A function declared inside a loop can't leave that loop.
+   if( loops.empty() || loops.back().function != currentBlock()->getParent() ) {
+      return nullptr;
+   }
+   return &loops.back();
+}
+
+bool CodeGenContext::isSpeculatable(llvm::BasicBlock* block)
+{
+   constexpr size_t maxInstructions = 8;
+   if( block->size() > maxInstructions ) {
+      return false;
+   }
+   for( auto& inst : *block ) {
+      if( !isSafeToSpeculativelyExecute(&inst) ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool CodeGenContext::parseFastMath(const std::string& option, llvm::FastMathFlags& flags)
+{
+   static const std::string name = "fast-math";
+   if( option == name ) {
+      flags.setFast();
+      return true;
+   }
+   if( option.compare(0, name.size() + 1, name + "=") != 0 ) {
+      return false;
+   }
+   using Setter = void (FastMathFlags::*)(bool);
+   static const std::map<std::string, Setter> setters{
+      {"reassoc", &FastMathFlags::setAllowReassoc},  {"contract", &FastMathFlags::setAllowContract},
+      {"nnan", &FastMathFlags::setNoNaNs},           {"ninf", &FastMathFlags::setNoInfs},
+      {"nsz", &FastMathFlags::setNoSignedZeros},     {"arcp", &FastMathFlags::setAllowReciprocal},
+      {"afn", &FastMathFlags::setApproxFunc}};
+   size_t begin = name.size() + 1;
+   while( begin <= option.size() ) {
+      size_t end = std::min(option.find(',', begin), option.size());
+      auto found = setters.find(option.substr(begin, end - begin));
+      if( found == setters.end() ) {
+         return false;
+      }
+      (flags.*found->second)(true);
+      begin = end + 1;
+   }
+   return true;
+}
+
+llvm::Value* CodeGenContext::applyFastMath(llvm::Value* value)
+{
+   auto inst = dyn_cast_or_null<Instruction>(value);
+   if( inst == nullptr || !isa<FPMathOperator>(inst) ) {
+      // Folded to a constant or no floating point operation.
+      return value;
+   }
+   FastMathFlags flags = fastMath;
+   if( flags.none() && fastMathFunctions.count(currentBlock()->getParent()) != 0 ) {
+      flags.setFast();
+   }
+   if( flags.any() ) {
+      inst->setFastMathFlags(flags);
+   }
+   return value;
+}
+
+void CodeGenContext::replaceFunction(llvm::Function* function, llvm::Function* replacement)
+{
+   // A later function may be created at the same address, it must not inherit anything.
+   if( fastMathFunctions.erase(function) != 0 && replacement != nullptr ) {
+      fastMathFunctions.insert(replacement);
+   }
+   if( replacement != nullptr ) {
+      setLiquidType(replacement, getLiquidType(function));
+   }
+}
+
+llvm::Value* CodeGenContext::createArray(llvm::Type* arrayType, llvm::Value* count)
+{
+   auto elementType = getArrayElementType(arrayType);
+   auto elementSize = ConstantInt::get(intType, getModule()->getDataLayout().getTypeAllocSize(elementType));
+   Value* data      = callBuiltin("liq_array_alloc", {count, elementSize});
+   return createArrayValue(arrayType, data, count);
+}
+
+llvm::Constant* CodeGenContext::getStringLiteral(const std::string& value)
+{
+   auto found = stringLiterals.find(value);
+   if( found != stringLiterals.end() ) {
+      return found->second;
+   }
+   // { capacity, length, characters }, the capacity of a literal is 0 since it is read only.
+   auto chars   = ConstantDataArray::getString(getGlobalContext(), value);
+   auto literal = ConstantStruct::getAnon(getGlobalContext(), {ConstantInt::get(intType, 0), ConstantInt::get(intType, value.size()), chars});
+   auto global  = new GlobalVariable(*getModule(), literal->getType(), true, GlobalValue::PrivateLinkage, literal, ".str");
+   global->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+   global->setAlignment(MaybeAlign(8));
+
+   auto      int32Type = Type::getInt32Ty(getGlobalContext());
+   auto      zero      = ConstantInt::get(int32Type, 0);
+   Constant* indices[] = {zero, ConstantInt::get(int32Type, 2), zero};
+   auto      str       = ConstantExpr::getInBoundsGetElementPtr(literal->getType(), global, indices);
+   stringLiterals[value] = str;
+   setLiquidType(str, "string");
+   return str;
+}
+
+llvm::Value* CodeGenContext::stringLength(llvm::Value* str)
+{
+   // The length is the 64 bit word in front of the characters.
+   auto ptr = GetElementPtrInst::CreateInBounds(intType, str, {ConstantInt::get(intType, -1, true)}, "len_ptr", currentBlock());
+   return new LoadInst(intType, ptr, "len", currentBlock());
+}
+
+llvm::Type* CodeGenContext::getMapType(const std::string& keyTypeName, const std::string& valueTypeName)
+{
+   std::string name = "map<" + keyTypeName + "," + valueTypeName + ">";
+   if( llvmTypeMap.count(name) != 0 ) {
+      return llvmTypeMap[name];
+   }
+   auto isKey   = [&](const MapKeyType& key) { return keyTypeName == key.name; };
+   auto isValue = [&](const char* value) { return valueTypeName == value; };
+   if( std::none_of(std::begin(mapKeyTypes), std::end(mapKeyTypes), isKey) || std::none_of(std::begin(mapValueTypes), std::end(mapValueTypes), isValue) ) {
+      return nullptr;
+   }
+   auto keyType   = typeOf(keyTypeName);
+   auto valueType = typeOf(valueTypeName);
+   // A map is passed by value as {table}, the named type keeps the maps of different key and value types apart.
+   auto mapType = StructType::create(getGlobalContext(), {PointerType::getUnqual(getGlobalContext())}, "map." + keyTypeName + "." + valueTypeName);
+   llvmTypeMap[name] = mapType;
+   mapTypes[mapType] = {keyType, valueType};
+   return mapType;
+}
+
+std::string CodeGenContext::mapKeySuffix(llvm::Type* keyType)
+{
+   auto key = std::find_if(std::begin(mapKeyTypes), std::end(mapKeyTypes), [&](const MapKeyType& key) { return typeOf(key.name) == keyType; });
+   return key->suffix;
+}
+
+llvm::Value* CodeGenContext::createMap(llvm::Type* mapType)
+{
+   Value* table = callBuiltin("liq_map_new" + mapKeySuffix(getMapKeyType(mapType)), {});
+   return InsertValueInst::Create(PoisonValue::get(mapType), table, {0}, "map", currentBlock());
+}
+
+llvm::Type* CodeGenContext::getSoaType(const std::string& klass)
+{
+   std::string name = "soa<" + klass + ">";
+   if( llvmTypeMap.count(name) != 0 ) {
+      return llvmTypeMap[name];
+   }
+   if( classTypeMap.count(klass) == 0 ) {
+      return nullptr;
+   }
+   for( auto fieldType : cast<StructType>(classTypeMap[klass])->elements() ) {
+      if( fieldType != intType && fieldType != doubleType && fieldType != boolType ) {
+         return nullptr;
+      }
+   }
+   if( soaTableType == nullptr ) {
+      // { length, capacity, column count, columns }, see buildins_soa.cpp
+      auto ptrType = PointerType::getUnqual(getGlobalContext());
+      soaTableType = StructType::create(getGlobalContext(), {intType, intType, intType, ArrayType::get(ptrType, 0)}, "soa.table");
+   }
+   // Like a map it is passed by value as {table}.
+   auto soaType = StructType::create(getGlobalContext(), {PointerType::getUnqual(getGlobalContext())}, "soa." + klass);
+   llvmTypeMap[name] = soaType;
+   soaTypes[soaType] = klass;
+   return soaType;
+}
+
+llvm::Value* CodeGenContext::createSoa(llvm::Type* soaType)
+{
+   auto klassType = cast<StructType>(classTypeMap[getSoaClassName(soaType)]);
+   Value* table = callBuiltin("liq_soa_new", {ConstantInt::get(intType, klassType->getNumElements())});
+   return InsertValueInst::Create(PoisonValue::get(soaType), table, {0}, "soa", currentBlock());
+}
+
+llvm::Value* CodeGenContext::soaLength(llvm::Value* soa)
+{
+   // The length is the first word of the table.
+   auto table = ExtractValueInst::Create(soa, {0}, "table", currentBlock());
+   return new LoadInst(intType, table, "len", currentBlock());
+}
+
+/*! Returns the pointer to the first element of the column of the struct field index. */
+static Value* soaColumnData(Value* table, unsigned index, StructType* tableType, BasicBlock* block)
+{
+   auto& ctx     = block->getContext();
+   auto  intType = Type::getInt64Ty(ctx);
+   Value* indices[] = {ConstantInt::get(intType, 0), ConstantInt::get(Type::getInt32Ty(ctx), 3), ConstantInt::get(intType, index)};
+   auto  ptr     = GetElementPtrInst::CreateInBounds(tableType, table, indices, "column_ptr", block);
+   return new LoadInst(PointerType::getUnqual(ctx), ptr, "column", block);
+}
+
+llvm::Value* CodeGenContext::soaColumn(llvm::Value* soa, const std::string& member)
+{
+   auto klass = getSoaClassName(soa->getType());
+   if( classAttributes[klass].count(member) == 0 ) {
+      return nullptr;
+   }
+   auto [index, memberType] = classAttributes[klass][member];
+   auto table               = ExtractValueInst::Create(soa, {0}, "table", currentBlock());
+   auto data                = soaColumnData(table, index, soaTableType, currentBlock());
+   auto arrayType           = memberType == doubleType ? doubleArrayType : intArrayType;
+   return createArrayValue(arrayType, data, soaLength(soa));
+}
+
+llvm::Value* CodeGenContext::soaAppend(llvm::Value* soa, llvm::Value* object)
+{
+   auto klass     = getSoaClassName(soa->getType());
+   auto klassType = cast<StructType>(classTypeMap[klass]);
+   auto table     = ExtractValueInst::Create(soa, {0}, "table", currentBlock());
+   auto index     = callBuiltin("liq_soa_append", {table});
+   // The columns are read after the append, since it may have moved them.
+   for( unsigned i = 0; i < klassType->getNumElements(); ++i ) {
+      auto fieldType = klassType->getElementType(i);
+      auto field     = GetElementPtrInst::CreateInBounds(klassType, object, {ConstantInt::get(intType, 0), ConstantInt::get(Type::getInt32Ty(getGlobalContext()), i)}, "field", currentBlock());
+      Value* value   = new LoadInst(fieldType, field, "value", false, getFieldAlign(klassType, i), currentBlock());
+      if( fieldType == boolType ) {
+         value = CastInst::Create(Instruction::ZExt, value, intType, "word", currentBlock());
+      }
+      auto column  = soaColumnData(table, i, soaTableType, currentBlock());
+      auto element = GetElementPtrInst::CreateInBounds(value->getType(), column, {index}, "element", currentBlock());
+      new StoreInst(value, element, currentBlock());
+   }
+   return index;
+}
+
+llvm::Value* CodeGenContext::soaRecord(llvm::Value* soa, llvm::Value* index)
+{
+   auto klass     = getSoaClassName(soa->getType());
+   auto klassType = cast<StructType>(classTypeMap[klass]);
+   auto table     = ExtractValueInst::Create(soa, {0}, "table", currentBlock());
+   auto object    = createObject(klassType);
+   for( unsigned i = 0; i < klassType->getNumElements(); ++i ) {
+      auto fieldType = klassType->getElementType(i);
+      auto column    = soaColumnData(table, i, soaTableType, currentBlock());
+      auto element   = GetElementPtrInst::CreateInBounds(fieldType == doubleType ? doubleType : intType, column, {index}, "element", currentBlock());
+      Value* value   = new LoadInst(fieldType == doubleType ? doubleType : intType, element, "value", currentBlock());
+      if( fieldType == boolType ) {
+         value = CastInst::Create(Instruction::Trunc, value, boolType, "value", currentBlock());
+      }
+      auto field = GetElementPtrInst::CreateInBounds(klassType, object, {ConstantInt::get(intType, 0), ConstantInt::get(Type::getInt32Ty(getGlobalContext()), i)}, "field", currentBlock());
+      new StoreInst(value, field, false, getFieldAlign(klassType, i), currentBlock());
+   }
+   return object;
+}
+
+void CodeGenContext::freeTables(llvm::Function& function)
+{
+   auto calls = [](Value* value, const std::string& prefix) {
+      auto call = dyn_cast<CallInst>(value);
+      return call != nullptr && call->getCalledFunction() != nullptr && call->getCalledFunction()->getName().str().compare(0, prefix.size(), prefix) == 0;
+   };
+   // The table of a struct of arrays is also read directly, its length and its columns.
+   auto usesTable = [&](User* user, const std::string& prefix) {
+      if( calls(user, prefix) ) {
+         return true;
+      }
+      auto gep = dyn_cast<GetElementPtrInst>(user);
+      return prefix == "liq_soa_" && (isa<LoadInst>(user) || (gep != nullptr && gep->getSourceElementType() == soaTableType));
+   };
+   std::vector<AllocaInst*> owners;
+   for( auto& inst : instructions(function) ) {
+      auto var = dyn_cast<AllocaInst>(&inst);
+      if( var == nullptr || (!isMapType(var->getAllocatedType()) && !isSoaType(var->getAllocatedType())) ) {
+         continue;
+      }
+      std::string prefix = isMapType(var->getAllocatedType()) ? "liq_map_" : "liq_soa_";
+      bool        owns   = !var->use_empty();
+      for( auto user : var->users() ) {
+         if( auto store = dyn_cast<StoreInst>(user) ) {
+            auto table = dyn_cast<InsertValueInst>(store->getValueOperand());
+            owns &= store->getPointerOperand() == var && table != nullptr && calls(table->getInsertedValueOperand(), prefix + "new");
+         } else if( auto load = dyn_cast<LoadInst>(user) ) {
+            for( auto loadUser : load->users() ) {
+               auto table = dyn_cast<ExtractValueInst>(loadUser);
+               owns &= table != nullptr && std::all_of(table->user_begin(), table->user_end(), [&](User* tableUser) { return usesTable(tableUser, prefix); });
+            }
+         } else {
+            owns = false;
+         }
+      }
+      if( owns ) {
+         owners.push_back(var);
+      }
+   }
+
+   auto& entry = function.getEntryBlock();
+   for( auto var : owners ) {
+      auto free = getModule()->getFunction(isMapType(var->getAllocatedType()) ? "liq_map_free" + mapKeySuffix(getMapKeyType(var->getAllocatedType())) : "liq_soa_free");
+      auto freeTable = [&](Instruction* before) {
+         IRBuilder<> builder(before);
+         builder.CreateCall(free, {builder.CreateExtractValue(builder.CreateLoad(var->getAllocatedType(), var), {0}, "table")});
+      };
+      // The variable may be declared in a loop or in a branch, so it lives in the entry block and starts without a table.
+      var->moveBefore(&*entry.getFirstInsertionPt());
+      new StoreInst(Constant::getNullValue(var->getAllocatedType()), var, var->getNextNode());
+      for( auto user : std::vector<User*>(var->user_begin(), var->user_end()) ) {
+         auto store = dyn_cast<StoreInst>(user);
+         if( store != nullptr && !isa<Constant>(store->getValueOperand()) ) {
+            freeTable(store);
+         }
+      }
+      for( auto& bb : function ) {
+         auto ret = dyn_cast<ReturnInst>(bb.getTerminator());
+         if( ret == nullptr ) {
+            continue;
+         }
+         // Freed before a call, which may become a tail call.
+         auto call = dyn_cast_or_null<CallInst>(ret->getPrevNode());
+         freeTable(call != nullptr && call->getCallingConv() == CallingConv::Tail ? static_cast<Instruction*>(call) : ret);
+      }
+   }
+}
+
+namespace
+{
+/*! Follows the uses of the storage of a typed array: the array, its data and the pointers into it.
+ * A cycle of variables, arguments or functions followed is taken as fine, so a check starts with a new object.
+ */
+class ArrayUses
+{
+public:
+   explicit ArrayUses(const CodeGenContext& context) : context(context) {}
+
+   /*! Returns true if the storage doesn't outlive the function, it is only read, written and passed to functions,
+    *  which don't keep it. The array may only leave by sink, e.g. the store into the variable owning it, or,
+    *  if variables is true, by a store into a variable, whose values stay too.
+    *  The instructions of the function using the storage are added to uses.
+    */
+   bool stay(Value* value, const Instruction* sink, bool variables, std::vector<Instruction*>& uses)
+   {
+      for( auto user : value->users() ) {
+         auto inst = dyn_cast<Instruction>(user);
+         if( inst == nullptr ) {
+            return false;
+         }
+         uses.push_back(inst);
+         bool stays = inst == sink;
+         if( stays ) {
+            continue;
+         }
+         if( auto extract = dyn_cast<ExtractValueInst>(inst) ) {
+            // The length is a number, the data points to the storage.
+            stays = extract->getIndices()[0] == 1 || stay(extract, sink, variables, uses);
+         } else if( auto insert = dyn_cast<InsertValueInst>(inst) ) {
+            // A view of the storage, e.g. a slice, or the array with its length.
+            stays = context.isArrayType(insert->getType()) && stay(insert, sink, variables, uses);
+         } else if( auto gep = dyn_cast<GetElementPtrInst>(inst) ) {
+            stays = gep->getPointerOperand() == value && stay(gep, sink, variables, uses);
+         } else if( auto store = dyn_cast<StoreInst>(inst) ) {
+            // An element is assigned or the array is assigned to a variable.
+            auto var = dyn_cast<AllocaInst>(store->getPointerOperand());
+            stays = store->getValueOperand() != value || (variables && var != nullptr && variableStays(var));
+         } else if( auto call = dyn_cast<CallInst>(inst) ) {
+            stays = passed(call, value);
+         } else {
+            stays = isa<LoadInst>(inst);
+         }
+         if( !stays ) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /*! Returns true if the values of the variable stay in the function, e.g. the ones of a parameter. */
+   bool variableStays(AllocaInst* var)
+   {
+      if( !context.isArrayType(var->getAllocatedType()) ) {
+         return false;
+      }
+      if( !visited.insert(var).second ) {
+         return true;
+      }
+      for( auto user : var->users() ) {
+         auto store = dyn_cast<StoreInst>(user);
+         auto load  = dyn_cast<LoadInst>(user);
+         std::vector<Instruction*> uses;
+         if( store != nullptr ? store->getPointerOperand() != var : (load == nullptr || !stay(load, nullptr, true, uses)) ) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /*! Returns true if each return of the function returns a new array, which the caller owns. */
+   bool returnsNewArray(Function* function)
+   {
+      if( function->isDeclaration() || !context.isArrayType(function->getReturnType()) ) {
+         return false;
+      }
+      if( !visited.insert(function).second ) {
+         return true;
+      }
+      for( auto& bb : *function ) {
+         auto ret = dyn_cast_or_null<ReturnInst>(bb.getTerminator());
+         if( ret == nullptr ) {
+            continue;
+         }
+         auto storage = newStorage(ret->getReturnValue());
+         std::vector<Instruction*> uses;
+         if( storage == nullptr || !stay(storage, ret, false, uses) ) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /*! Returns the storage of a new array, the allocation or the call of a function returning a new array, otherwise nullptr. */
+   CallInst* newStorage(Value* array)
+   {
+      if( auto call = dyn_cast_or_null<CallInst>(array) ) {
+         return call->getCalledFunction() != nullptr && returnsNewArray(call->getCalledFunction()) ? call : nullptr;
+      }
+      // A new array is built by inserting the allocated storage and the length.
+      auto insert = dyn_cast_or_null<InsertValueInst>(array);
+      while( insert != nullptr && insert->getIndices()[0] != 0 ) {
+         insert = dyn_cast<InsertValueInst>(insert->getAggregateOperand());
+      }
+      auto alloc = insert != nullptr ? dyn_cast<CallInst>(insert->getInsertedValueOperand()) : nullptr;
+      return isAllocation(alloc) ? alloc : nullptr;
+   }
+
+   /*! Returns true if the value is the allocation of the storage of an array. */
+   static bool isAllocation(Value* value)
+   {
+      auto call = dyn_cast_or_null<CallInst>(value);
+      return call != nullptr && call->getCalledFunction() != nullptr && call->getCalledFunction()->getName() == "liq_array_alloc";
+   }
+
+private:
+   /*! Returns true if the function called keeps no reference to the storage passed as argument. */
+   bool passed(CallInst* call, Value* value)
+   {
+      auto callee = call->getCalledFunction();
+      if( callee == nullptr ) {
+         return false;
+      }
+      for( unsigned i = 0; i < call->arg_size(); ++i ) {
+         if( call->getArgOperand(i) != value ) {
+            continue;
+         }
+         // A built in function or an intrinsic like memcpy only uses the storage while it runs.
+         if( callee->isDeclaration() ? !call->doesNotCapture(i) : (visited.insert(callee->getArg(i)).second && !argumentStays(callee->getArg(i))) ) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   bool argumentStays(Argument* arg)
+   {
+      std::vector<Instruction*> uses;
+      return stay(arg, nullptr, true, uses);
+   }
+
+   const CodeGenContext&   context;
+   SmallPtrSet<Value*, 16> visited; ///< The variables, arguments and functions followed so far.
+};
+} // namespace
+
+void CodeGenContext::freeArrays(llvm::Function& function)
+{
+   auto free = getModule()->getFunction("liq_array_free");
+   // Frees the storage of the array, a new array or the value of a variable.
+   auto freeArray = [&](Value* array, Instruction* before) {
+      IRBuilder<> builder(before);
+      if( auto var = dyn_cast<AllocaInst>(array) ) {
+         array = builder.CreateLoad(var->getAllocatedType(), var);
+      }
+      builder.CreateCall(free, {array->getType()->isPointerTy() ? array : builder.CreateExtractValue(array, {0}, "data")});
+   };
+
+   std::vector<CallInst*>                         storages;
+   std::vector<AllocaInst*>                       owners;
+   std::map<AllocaInst*, std::set<Instruction*>> ownerUses; ///< The instructions using the array of an owner
+   for( auto& inst : instructions(function) ) {
+      if( auto call = dyn_cast<CallInst>(&inst) ) {
+         if( ArrayUses::isAllocation(call) || (call->getCalledFunction() != nullptr && ArrayUses(*this).returnsNewArray(call->getCalledFunction())) ) {
+            storages.push_back(call);
+         }
+      }
+      auto var = dyn_cast<AllocaInst>(&inst);
+      if( var == nullptr || !isArrayType(var->getAllocatedType()) ) {
+         continue;
+      }
+      // A variable owns its array, if it only gets new arrays and its value is only used in place.
+      bool                      owns = !var->use_empty();
+      std::vector<Instruction*> uses;
+      for( auto user : var->users() ) {
+         if( auto store = dyn_cast<StoreInst>(user) ) {
+            if( store->getPointerOperand() != var || isa<Constant>(store->getValueOperand()) ) {
+               owns &= store->getPointerOperand() == var;
+               continue;
+            }
+            auto                      storage = ArrayUses(*this).newStorage(store->getValueOperand());
+            std::vector<Instruction*> storageUses;
+            owns &= storage != nullptr && ArrayUses(*this).stay(storage, store, false, storageUses);
+         } else if( auto load = dyn_cast<LoadInst>(user) ) {
+            owns &= ArrayUses(*this).stay(load, nullptr, false, uses);
+         } else {
+            owns = false;
+         }
+      }
+      if( owns ) {
+         owners.push_back(var);
+         ownerUses[var].insert(uses.begin(), uses.end());
+      }
+   }
+
+   // A temporary array, e.g. the result of a + b passed to sum(), is freed after its last use.
+   std::vector<std::pair<CallInst*, Instruction*>> temporaries;
+   for( auto storage : storages ) {
+      std::vector<Instruction*> uses;
+      if( !ArrayUses(*this).stay(storage, nullptr, false, uses) ) {
+         continue;
+      }
+      // Only an array used in the block it is created in, else it is kept.
+      Instruction* last = storage;
+      for( auto use : uses ) {
+         last = (last == nullptr || use->getParent() != storage->getParent()) ? nullptr : (last->comesBefore(use) ? use : last);
+      }
+      if( last != nullptr ) {
+         temporaries.push_back({storage, last});
+      }
+   }
+   for( auto& temporary : temporaries ) {
+      freeArray(temporary.first, temporary.second->getNextNode());
+   }
+
+   auto& entry = function.getEntryBlock();
+   for( auto var : owners ) {
+      // The variable may be declared in a loop or in a branch, so it lives in the entry block and starts without an array.
+      var->moveBefore(&*entry.getFirstInsertionPt());
+      new StoreInst(Constant::getNullValue(var->getAllocatedType()), var, var->getNextNode());
+      for( auto user : std::vector<User*>(var->user_begin(), var->user_end()) ) {
+         auto store = dyn_cast<StoreInst>(user);
+         if( store != nullptr && !isa<Constant>(store->getValueOperand()) ) {
+            freeArray(var, store);
+         }
+      }
+      for( auto& bb : function ) {
+         auto ret = dyn_cast<ReturnInst>(bb.getTerminator());
+         if( ret == nullptr ) {
+            continue;
+         }
+         // Freed before a call, which may become a tail call, unless the call gets the array.
+         auto call = dyn_cast_or_null<CallInst>(ret->getPrevNode());
+         bool tail = call != nullptr && call->getCallingConv() == CallingConv::Tail && ownerUses[var].count(call) == 0;
+         freeArray(var, tail ? static_cast<Instruction*>(call) : ret);
+      }
+   }
+}
+
+llvm::Value* CodeGenContext::convertMapItem(llvm::Value* item, llvm::Type* type)
+{
+   if( type == doubleType && item->getType() == intType ) {
+      return CastInst::Create(Instruction::SIToFP, item, doubleType, "castdb", currentBlock());
+   }
+   if( type == stringType ) {
+      return isString(item) ? item : nullptr;
+   }
+   return item->getType() == type ? item : nullptr;
+}
+
+llvm::Value* CodeGenContext::callMapBuiltin(const std::string& operation, llvm::Value* map, llvm::Value* key, llvm::Value* value)
+{
+   auto table = ExtractValueInst::Create(map, {0}, "table", currentBlock());
+   if( operation == "len" ) {
+      return callBuiltin("liq_map_len", {table});
+   }
+
+   auto name      = "liq_map_" + operation + mapKeySuffix(getMapKeyType(map->getType()));
+   auto valueType = getMapValueType(map->getType());
+   auto toWord    = [&](Value* item) -> Value* {
+      if( item->getType() == doubleType ) {
+         return CastInst::Create(Instruction::BitCast, item, intType, "word", currentBlock());
+      }
+      if( item->getType() == boolType ) {
+         return CastInst::Create(Instruction::ZExt, item, intType, "word", currentBlock());
+      }
+      if( item->getType() == stringType ) {
+         return CastInst::Create(Instruction::PtrToInt, item, intType, "word", currentBlock());
+      }
+      return item;
+   };
+
+   if( operation == "put" ) {
+      return callBuiltin(name, {table, key, toWord(value)});
+   }
+   if( operation == "get" ) {
+      if( value == nullptr ) {
+         // A missing key yields the zero value, for a string the empty one.
+         value = valueType == stringType ? getStringLiteral("") : Constant::getNullValue(valueType);
+      }
+      Value* word = callBuiltin(name, {table, key, toWord(value)});
+      if( valueType == doubleType ) {
+         return CastInst::Create(Instruction::BitCast, word, doubleType, "value", currentBlock());
+      }
+      if( valueType == boolType ) {
+         return CastInst::Create(Instruction::Trunc, word, boolType, "value", currentBlock());
+      }
+      if( valueType == stringType ) {
+         auto str = CastInst::Create(Instruction::IntToPtr, word, stringType, "value", currentBlock());
+         setLiquidType(str, "string");
+         return str;
+      }
+      return word;
+   }
+   // contains and remove
+   Value* found = callBuiltin(name, {table, key});
+   return CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_NE, found, ConstantInt::get(intType, 0), "found", currentBlock());
+}
+
+llvm::Value* CodeGenContext::createArrayValue(llvm::Type* arrayType, llvm::Value* data, llvm::Value* count)
+{
+   Value* array = InsertValueInst::Create(PoisonValue::get(arrayType), data, {0}, "array", currentBlock());
+   return InsertValueInst::Create(array, count, {1}, "array", currentBlock());
+}
+
+llvm::Value* CodeGenContext::arrayViewOf(llvm::Value* value, llvm::Type* arrayType)
+{
+   if( isArrayType(value->getType()) ) {
+      return (arrayType == nullptr || value->getType() == arrayType) ? value : nullptr;
+   }
+   auto load = dyn_cast<LoadInst>(value);
+   auto list = dyn_cast<AllocaInst>(load != nullptr ? load->getPointerOperand() : value);
+   if( list == nullptr || !list->getAllocatedType()->isStructTy() || !findClassNameByType(list->getAllocatedType()).empty() ) {
+      return nullptr;
+   }
+   auto listType = cast<StructType>(list->getAllocatedType());
+   if( listType->getNumElements() == 0 ) {
+      return nullptr;
+   }
+   auto elementType = listType->getElementType(0);
+   auto viewType    = getArrayType(elementType);
+   bool homogeneous = std::all_of(listType->element_begin(), listType->element_end(), [&](Type* ty) { return ty == elementType; });
+   if( viewType == nullptr || !homogeneous || (arrayType != nullptr && viewType != arrayType) ) {
+      return nullptr;
+   }
+   if( load != nullptr && load->use_empty() ) {
+      load->eraseFromParent();
+   }
+   // The elements of a homogeneous list are laid out like an array.
+   return createArrayValue(viewType, list, ConstantInt::get(intType, listType->getNumElements()));
+}
+
+namespace
+{
+void collectStoredElements(AllocaInst* list, ArrayRef<unsigned> indices, std::vector<Value*>& found, int depth);
+
+/*! Collects the values, which may be the element at indices of the list value aggregate. */
+void collectElements(Value* aggregate, ArrayRef<unsigned> indices, std::vector<Value*>& found, int depth)
+{
+   if( depth == 0 ) {
+      return;
+   }
+   if( indices.empty() ) {
+      found.push_back(aggregate);
+   } else if( auto extract = dyn_cast<ExtractValueInst>(aggregate) ) {
+      std::vector<unsigned> path(extract->getIndices().begin(), extract->getIndices().end());
+      path.insert(path.end(), indices.begin(), indices.end());
+      collectElements(extract->getAggregateOperand(), path, found, depth - 1);
+   } else if( auto insert = dyn_cast<InsertValueInst>(aggregate) ) {
+      if( insert->getNumIndices() == 1 && insert->getIndices()[0] == indices[0] ) {
+         collectElements(insert->getInsertedValueOperand(), indices.drop_front(), found, depth - 1);
+      } else {
+         collectElements(insert->getAggregateOperand(), indices, found, depth - 1);
+      }
+   } else if( auto load = dyn_cast<LoadInst>(aggregate) ) {
+      if( auto list = dyn_cast<AllocaInst>(load->getPointerOperand()) ) {
+         collectStoredElements(list, indices, found, depth - 1);
+      }
+   }
+}
+
+/*! Collects the values stored as the element at indices into the list variable, as a whole or by element. */
+void collectStoredElements(AllocaInst* list, ArrayRef<unsigned> indices, std::vector<Value*>& found, int depth)
+{
+   auto listType = dyn_cast<StructType>(list->getAllocatedType());
+   if( listType == nullptr || !listType->isLiteral() ) {
+      return;
+   }
+   for( auto user : list->users() ) {
+      if( auto store = dyn_cast<StoreInst>(user) ) {
+         collectElements(store->getValueOperand(), indices, found, depth);
+         continue;
+      }
+      auto gep = dyn_cast<GetElementPtrInst>(user);
+      if( gep == nullptr || gep->getNumIndices() != 2 ) {
+         continue;
+      }
+      auto index = dyn_cast<ConstantInt>(gep->getOperand(2));
+      if( index == nullptr || index->getZExtValue() != indices[0] ) {
+         continue;
+      }
+      for( auto gepUser : gep->users() ) {
+         auto store = dyn_cast<StoreInst>(gepUser);
+         if( store != nullptr && store->getPointerOperand() == gep ) {
+            collectElements(store->getValueOperand(), indices.drop_front(), found, depth);
+         }
+      }
+   }
+}
+
+/*! Returns the values, which may be stored in a list as the element array, e.g. l[0], or nothing if array isn't an element of a list.
+ * The elements of a list literal are generated in place, so the stores into the list give them.
+ */
+std::vector<Value*> listElementSources(Value* array)
+{
+   // Deep enough for nested lists, the limit stops at lists assigned to themselves.
+   constexpr int       maxDepth = 16;
+   std::vector<Value*> found;
+   if( auto extract = dyn_cast<ExtractValueInst>(array) ) {
+      collectElements(extract->getAggregateOperand(), extract->getIndices(), found, maxDepth);
+   } else if( auto load = dyn_cast<LoadInst>(array) ) {
+      auto gep  = dyn_cast<GetElementPtrInst>(load->getPointerOperand());
+      auto list = gep != nullptr ? dyn_cast<AllocaInst>(gep->getPointerOperand()) : nullptr;
+      if( list != nullptr && gep->getNumIndices() == 2 && isa<ConstantInt>(gep->getOperand(2)) ) {
+         unsigned index = cast<ConstantInt>(gep->getOperand(2))->getZExtValue();
+         collectStoredElements(list, {index}, found, maxDepth);
+      }
+   }
+   return found;
+}
+} // namespace
+
+bool CodeGenContext::mayBeStackView(llvm::Value* array) const
+{
+   if( isa<Argument>(array) ) {
+      // The caller may pass a view of its own list.
+      return true;
+   }
+   auto sources = listElementSources(array);
+   if( !sources.empty() ) {
+      return std::any_of(sources.begin(), sources.end(), [this](Value* value) { return mayBeStackView(value); });
+   }
+   if( auto load = dyn_cast<LoadInst>(array) ) {
+      auto var = dyn_cast<AllocaInst>(load->getPointerOperand());
+      return var != nullptr && stackViews.count(var) != 0;
+   }
+   if( auto phi = dyn_cast<PHINode>(array) ) {
+      return std::any_of(phi->incoming_values().begin(), phi->incoming_values().end(), [this](Value* value) { return mayBeStackView(value); });
+   }
+   if( auto select = dyn_cast<SelectInst>(array) ) {
+      return mayBeStackView(select->getTrueValue()) || mayBeStackView(select->getFalseValue());
+   }
+   // An array value built by createArrayValue, look where its data comes from.
+   auto insert = dyn_cast<InsertValueInst>(array);
+   while( insert != nullptr && insert->getIndices()[0] != 0 ) {
+      insert = dyn_cast<InsertValueInst>(insert->getAggregateOperand());
+   }
+   if( insert == nullptr ) {
+      return false;
+   }
+   auto data = getUnderlyingObject(insert->getInsertedValueOperand());
+   if( isa<AllocaInst>(data) ) {
+      return true;
+   }
+   // A slice of an array is as valid as the array.
+   auto extract = dyn_cast<ExtractValueInst>(data);
+   return extract != nullptr && mayBeStackView(extract->getAggregateOperand());
+}
+
+bool CodeGenContext::isSoaColumnView(llvm::Value* array) const
+{
+   auto sources = listElementSources(array);
+   if( !sources.empty() ) {
+      return std::any_of(sources.begin(), sources.end(), [this](Value* value) { return isSoaColumnView(value); });
+   }
+   auto insert = dyn_cast<InsertValueInst>(array);
+   while( insert != nullptr && insert->getIndices()[0] != 0 ) {
+      insert = dyn_cast<InsertValueInst>(insert->getAggregateOperand());
+   }
+   if( insert == nullptr ) {
+      return false;
+   }
+   // The column is loaded from the table, see soaColumn.
+   auto data = getUnderlyingObject(insert->getInsertedValueOperand());
+   if( auto column = dyn_cast<LoadInst>(data) ) {
+      auto gep = dyn_cast<GetElementPtrInst>(column->getPointerOperand());
+      return gep != nullptr && gep->getSourceElementType() == soaTableType;
+   }
+   auto extract = dyn_cast<ExtractValueInst>(data);
+   return extract != nullptr && isSoaColumnView(extract->getAggregateOperand());
+}
+
+llvm::Value* CodeGenContext::escapingArray(llvm::Value* array)
+{
+   if( !isArrayType(array->getType()) || (!mayBeStackView(array) && !isSoaColumnView(array)) ) {
+      return array;
+   }
+   return copyArray(array);
+}
+
+llvm::Value* CodeGenContext::copyArray(llvm::Value* array)
+{
+   IRBuilder<> builder(currentBlock());
+   auto        data        = builder.CreateExtractValue(array, {0}, "data");
+   auto        len         = builder.CreateExtractValue(array, {1}, "len");
+   auto        copy        = createArray(array->getType(), len);
+   auto        elementSize = getModule()->getDataLayout().getTypeAllocSize(getArrayElementType(array->getType()));
+   auto        bytes       = builder.CreateMul(len, builder.getInt64(elementSize), "bytes");
+   builder.CreateMemCpy(builder.CreateExtractValue(copy, {0}, "data"), MaybeAlign(8), data, MaybeAlign(8), bytes);
+   return copy;
+}
+
+llvm::Value* CodeGenContext::escapingList(llvm::Value* list)
+{
+   auto listType = dyn_cast<StructType>(list->getType());
+   if( listType == nullptr || !listType->isLiteral() ) {
+      return list;
+   }
+   IRBuilder<> builder(currentBlock());
+   Value*      result = list;
+   for( unsigned i = 0; i < listType->getNumElements(); ++i ) {
+      auto elementType = listType->getElementType(i);
+      if( !isArrayType(elementType) && !(elementType->isStructTy() && cast<StructType>(elementType)->isLiteral()) ) {
+         continue;
+      }
+      auto element  = builder.CreateExtractValue(list, {i}, "element");
+      auto escaping = isArrayType(elementType) ? escapingArray(element) : escapingList(element);
+      if( escaping != element ) {
+         result = builder.CreateInsertValue(result, escaping, {i}, "ret_list");
+      } else if( auto unused = dyn_cast<Instruction>(element) ) {
+         unused->eraseFromParent();
+      }
+   }
+   return result;
+}
+
+llvm::Value* CodeGenContext::convertToArray(llvm::Value* value, llvm::Type* arrayType)
+{
+   auto valueType = value->getType();
+   if( valueType == arrayType ) {
+      return value;
+   }
+   if( isArrayType(valueType) ) {
+      // Only widening int[] -> double[] is done implicitly.
+      if( valueType != intArrayType || arrayType != doubleArrayType ) {
+         return nullptr;
+      }
+      auto data   = ExtractValueInst::Create(value, {0}, "data", currentBlock());
+      auto len    = ExtractValueInst::Create(value, {1}, "len", currentBlock());
+      auto result = createArray(arrayType, len);
+      callBuiltin("liq_cvt_i64_f64", {ExtractValueInst::Create(result, {0}, "data", currentBlock()), data, len});
+      return result;
+   }
+
+   // A list is either still on the stack (alloca) or loaded as a struct value.
+   StructType* listType = nullptr;
+   auto load = dyn_cast<LoadInst>(value);
+   auto var  = load != nullptr ? dyn_cast<AllocaInst>(load->getPointerOperand()) : nullptr;
+   if( var != nullptr && var->getAllocatedType()->isStructTy() ) {
+      // Loading a variable of a big list as a whole is expensive, read the elements from the variable itself.
+      value = var;
+   }
+   AllocaInst* listAlloca = dyn_cast<AllocaInst>(value);
+   if( listAlloca != nullptr && listAlloca->getAllocatedType()->isStructTy() ) {
+      listType = cast<StructType>(listAlloca->getAllocatedType());
+   } else if( valueType->isStructTy() ) {
+      listType   = cast<StructType>(valueType);
+      listAlloca = nullptr;
+   } else {
+      return nullptr;
+   }
+   if( !findClassNameByType(listType).empty() || isArrayType(listType) ) {
+      return nullptr;
+   }
+   auto elementType = getArrayElementType(arrayType);
+   for( auto ty : listType->elements() ) {
+      if( ty != elementType && !(ty == intType && elementType == doubleType) ) {
+         return nullptr;
+      }
+   }
+   if( value == var && load->use_empty() ) {
+      // Dropped only now, if the list can't be converted the caller still uses the loaded value.
+      load->eraseFromParent();
+   }
+
+   auto count  = listType->getNumElements();
+   auto result = createArray(arrayType, ConstantInt::get(intType, count));
+   auto data   = ExtractValueInst::Create(result, {0}, "data", currentBlock());
+   bool sameLayout = std::all_of(listType->element_begin(), listType->element_end(), [&](Type* ty) { return ty == elementType; });
+   if( listAlloca != nullptr && sameLayout ) {
+      // A list of equal elements has the layout of an array, e.g. a constant table.
+      IRBuilder<> builder(currentBlock());
+      builder.CreateMemCpy(data, MaybeAlign(), listAlloca, listAlloca->getAlign(), getModule()->getDataLayout().getTypeAllocSize(listType));
+      return result;
+   }
+   for( unsigned index = 0; index < count; ++index ) {
+      Value* element = nullptr;
+      if( listAlloca != nullptr ) {
+         auto ptr = GetElementPtrInst::Create(listType, listAlloca, {ConstantInt::get(Type::getInt32Ty(getGlobalContext()), 0), ConstantInt::get(Type::getInt32Ty(getGlobalContext()), index)}, "", currentBlock());
+         element  = new LoadInst(listType->getElementType(index), ptr, "", currentBlock());
+      } else {
+         element = ExtractValueInst::Create(value, {index}, "", currentBlock());
+      }
+      if( element->getType() != elementType ) {
+         element = CastInst::Create(Instruction::SIToFP, element, elementType, "castdb", currentBlock());
+      }
+      auto ptr = GetElementPtrInst::Create(elementType, data, {ConstantInt::get(intType, index)}, "", currentBlock());
+      new StoreInst(element, ptr, currentBlock());
+   }
+   return result;
+}
+
 }
@@ -6,6 +6,7 @@
 #include <map>
 #include <list>
 #include <set>
+#include <unordered_map>
 
 #if defined(_MSC_VER)
 #pragma warning(push, 0)
@@ -21,10 +22,13 @@
 #include "llvm/IR/CallingConv.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/ValueMap.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include <llvm/Support/ManagedStatic.h>
 
 #if defined(_MSC_VER)
@@ -32,6 +36,7 @@
 #endif
 
 #include "AstNode.h"
+#include "TieredCompiler.h"
 
 namespace liquid
 {
@@ -42,19 +47,75 @@ enum class ScopeType {
    CodeBlock,
 };
 
+///< How the script is compiled.
+enum class CompileMode {
+   Auto,       ///< Latency for a small script without loops and recursion, throughput otherwise.
+   Latency,    ///< No optimizer and the fast instruction selection, the script starts at once.
+   Throughput, ///< The optimizer pipeline O2 and the full instruction selection.
+   Tiered,     ///< Starts like latency, the hot functions are optimized in the background (see TieredCompiler).
+};
+
 ///< Maps a variable name to its alloca instruction.
 using ValueNames = std::map<std::string, llvm::AllocaInst*>;
+///< Maps the name of a variable, which is never assigned, to its value.
+using ImmutableValues = std::map<std::string, llvm::Value*>;
 ///< Maps a variable name of a class definition to its position in the llvm structure type.
 using KlassValueNames = std::map<std::string, std::pair<int, llvm::Type*>>;
 ///< Maps a class name to its attributes (member variables).
 using KlassAttributes = std::map<std::string, KlassValueNames>;
 ///< Maps a variable name to its type name.
 using VariableTypeMap = std::map<std::string, std::string>;
-///< A set of assignments to hold the init code of class members
-using KlassInitCodeAssign = std::set<Assignment*>;
+///< The assignments of the init code of class members, in the order of their declaration
+using KlassInitCodeAssign = std::vector<Assignment*>;
 ///< Maps the init code to the class name.
 using KlassInitCode = std::map<std::string, KlassInitCodeAssign>;
 
+///< What a call is resolved by: the function name, the class of the receiver object (empty if none) and the count of arguments
+///< without the receiver.
+struct CallTarget
+{
+   static constexpr size_t variadic = ~size_t(0); ///< The arity of a function with variable arguments.
+
+   std::string name;
+   std::string klass;
+   size_t      arity;
+
+   bool operator==(const CallTarget& other) const { return arity == other.arity && name == other.name && klass == other.klass; }
+};
+
+struct CallTargetHash
+{
+   size_t operator()(const CallTarget& target) const
+   {
+      std::hash<std::string> hash;
+      return (hash(target.name) * 31 + hash(target.klass)) * 31 + target.arity;
+   }
+};
+
+///< The blocks a break or a continue of a loop jumps to.
+struct LoopTargets
+{
+   llvm::Function*   function; ///< The function containing the loop.
+   llvm::BasicBlock* exit;     ///< The block after the loop, the target of break.
+   llvm::BasicBlock* latch;    ///< The block going back to the condition, the target of continue.
+};
+
+///< A key type of the maps and the suffix of the runtime functions of such maps, like liq_map_get_i64.
+struct MapKeyType
+{
+   const char* name;
+   const char* suffix;
+};
+
+///< The key types of the maps, each has its own runtime functions.
+constexpr MapKeyType mapKeyTypes[] = {{"int", "_i64"}, {"double", "_f64"}, {"string", "_str"}};
+
+///< The value types of the maps, the runtime stores each of them as a 64 bit word.
+constexpr const char* mapValueTypes[] = {"int", "double", "string", "boolean"};
+
+///< Maps the calls to the functions they resolve to.
+using CallTargets = std::unordered_map<CallTarget, llvm::Function*, CallTargetHash>;
+
 ///< context of a scoped code block of expressions.
 class CodeGenBlock
 {
@@ -64,11 +125,13 @@ public:
    void              setCodeBlock(llvm::BasicBlock* bb) { bblock = bb; }
    llvm::BasicBlock* currentBlock() { return bblock; }
    ValueNames&       getValueNames() { return locals; }
+   ImmutableValues&  getImmutables() { return immutables; }
    VariableTypeMap&  getTypeMap() { return types; }
 
 private:
    llvm::BasicBlock* bblock{nullptr};
    ValueNames        locals;
+   ImmutableValues   immutables;
    VariableTypeMap   types;
 };
 
@@ -76,12 +139,19 @@ private:
 class CodeGenContext
 {
 public:
-   llvm::Value* varStruct{nullptr}; ///< Hold the alloc of the structure variable (class object). TODO move it to a better place.
    bool verbose {false};            ///< Verbose output
    bool debug {false};              ///< Dump the generated LLVM byte code.
+   std::string vectorLibrary;       ///< The vector math library used by the loop vectorizer (libmvec), empty for none.
+   llvm::FastMathFlags fastMath;    ///< The fast-math flags of all double arithmetic (-f fast-math), none by default.
+   CompileMode compileMode {CompileMode::Auto}; ///< Forced by -m latency, throughput or tiered.
 
    CodeGenContext(std::ostream & outs);
-   ~CodeGenContext() { llvm::llvm_shutdown(); }
+   ~CodeGenContext()
+   {
+      tiered.reset();
+      targetMachine.reset();
+      llvm::llvm_shutdown();
+   }
 
    llvm::Module*      getModule() const { return module; }
 
@@ -136,6 +206,19 @@ public:
     */
    llvm::AllocaInst* findVariable(std::string varName);
 
+   /*! Returns true if the variable is an int, double or boolean, which is never assigned after its declaration.
+    * Such a variable has no stack slot, its name refers to the value (see addImmutable).
+    */
+   bool isImmutableScalar(const VariableDeclaration& declaration, llvm::Type* type);
+
+   /*! Adds an immutable variable with its value to the current code block. */
+   void addImmutable(const std::string& varName, llvm::Value* value) { codeBlocks.front()->getImmutables()[varName] = value; }
+
+   /*! Searches an immutable variable like findVariable.
+    * \return The value of the variable or nullptr.
+    */
+   llvm::Value* findImmutable(const std::string& varName);
+
    /*! Deletes a variable name in all known locals of the current code block.
     *
     * \param[in] varName variable name
@@ -181,6 +264,9 @@ public:
     */
    llvm::Instruction* getKlassVarAccessInst(std::string klass, std::string name, llvm::AllocaInst * this_ptr);
 
+   /*! Returns the stream of the compile and the verbose messages, it is quiet with -q. */
+   std::ostream& getOutput() { return outs; }
+
    /*! Returns the currently processed class definition. */
    std::string getKlassName() { return klassName; }
 
@@ -193,7 +279,7 @@ public:
    /*! Returns type name based on LLVM Type */
    std::string typeNameOf(llvm::Type* type);
 
-   /*! Store the init code of the class to be used while creation. */
+   /*! Store the init code of the class to be used by its constructor, in the order of the member declarations. */
    void addKlassInitCode(std::string name, Assignment * assign);
 
    /*! Returns the class init code */
@@ -208,6 +294,31 @@ public:
    /*! Look up a class name of a given LLVM type. */
    std::string findClassNameByType(llvm::Type* ty);
 
+   /*! Allocates an uninitialized object of a class from the pool.
+    * \return The pointer to the object.
+    */
+   llvm::Value* createObject(llvm::Type* klassType);
+
+   /*! Records the liquid type of a value, e.g. "string" or the name of a class, since strings and objects are both a ptr.
+    * The value is the result of an expression, a variable (alloca), an instance variable (its address) or a function,
+    * whose result has the type.
+    */
+   void setLiquidType(llvm::Value* value, const std::string& typeName);
+
+   /*! Returns the recorded liquid type of a value or an empty string.
+    * A value loaded from a variable has the type of the variable, the result of a call the one of the function.
+    */
+   std::string getLiquidType(llvm::Value* value);
+
+   /*! Records the liquid types of the elements of a list (its alloca). */
+   void setListElementTypes(llvm::Value* list, std::vector<std::string> typeNames) { listElementTypes[list] = std::move(typeNames); }
+
+   /*! Returns the recorded liquid type of the element index of a list (its alloca) or an empty string. */
+   std::string getListElementType(llvm::Value* list, unsigned index);
+
+   /*! Returns the class name of an object by its liquid type, otherwise an empty string. */
+   std::string getObjectClassName(llvm::Value* object);
+
    /*! Returns the LLVM integer type used by liquid. */
    llvm::Type* getGenericIntegerType();
 
@@ -240,18 +351,241 @@ public:
    /*! Returns true if a template function is to be generated otherwise false. */
    bool codeGenTheTemplatedFunction() const { return generateTemplatedFunction; }
 
+   /*! Registers a function as the target of the calls name(arguments) or receiver.name(arguments).
+    * \param[in] name     Function name, as it is called.
+    * \param[in] klass    Class of the receiver, which is passed as first parameter. Empty for a function w/o receiver.
+    * \param[in] function The function, a registered one of the same name, receiver and arity is replaced.
+    */
+   void addCallTarget(const std::string& name, const std::string& klass, llvm::Function* function);
+
+   /*! Returns the function a call resolves to.
+    * \param[in] name  Function name.
+    * \param[in] klass Class of the receiver or empty.
+    * \param[in] arity Count of arguments w/o the receiver.
+    * \note Does return nullptr if there is no such function, the template functions aren't registered.
+    */
+   llvm::Function* findCallTarget(const std::string& name, const std::string& klass, size_t arity);
+
    llvm::Type* getType(Identifier const& ident);
    llvm::Type* getKlassMemberType(std::string const& klassName, std::string const& memberName);
+   /*! Returns the alignment of a member of the class objects, a member of a @packed class may be aligned less than its type. */
+   llvm::Align getKlassMemberAlign(std::string const& klassName, std::string const& memberName);
+   llvm::Align getFieldAlign(llvm::StructType* klassType, unsigned index);
+   bool hasKlassMember(std::string const& klassName, std::string const& memberName) { return classAttributes[klassName].count(memberName) != 0; }
+
+   /*! Returns true if the type is a typed numeric array (int[] or double[]). */
+   bool isArrayType(llvm::Type* ty) const { return ty != nullptr && (ty == intArrayType || ty == doubleArrayType); }
+
+   /*! Returns the typed array type holding elements of the given type, nullptr if there is none. */
+   llvm::Type* getArrayType(llvm::Type* elementType);
+
+   /*! Returns the element type of a typed array type. */
+   llvm::Type* getArrayElementType(llvm::Type* arrayType);
+
+   /*! Allocates the storage of a typed array.
+    * \param[in] arrayType The typed array type.
+    * \param[in] count     Number of elements.
+    * \return The array value {data, len}.
+    */
+   llvm::Value* createArray(llvm::Type* arrayType, llvm::Value* count);
+
+   /*! Creates a typed array value of existing storage.
+    * \param[in] arrayType The typed array type.
+    * \param[in] data      Pointer to the first element.
+    * \param[in] count     Number of elements.
+    */
+   llvm::Value* createArrayValue(llvm::Type* arrayType, llvm::Value* data, llvm::Value* count);
+
+   /*! Returns a typed array value viewing the elements of a list of numbers without copying them.
+    * \param[in] value     A typed array, a list variable (alloca) or a loaded list variable.
+    * \param[in] arrayType The wanted typed array type or nullptr for the one matching the elements.
+    * \return The view or nullptr if the list isn't homogeneous or not of the wanted type.
+    */
+   llvm::Value* arrayViewOf(llvm::Value* value, llvm::Type* arrayType = nullptr);
+
+   /*! Marks a typed array variable, which may hold a view of a list on the stack. */
+   void addStackView(llvm::AllocaInst* var) { stackViews.insert(var); }
+
+   /*! Returns true if the typed array may be a view of a list on the stack of the current function. */
+   bool mayBeStackView(llvm::Value* array) const;
+
+   /*! Returns true if the typed array is a view of a column of a struct of arrays, which moves when a record is added. */
+   bool isSoaColumnView(llvm::Value* array) const;
+
+   /*! Returns a typed array, which stays valid when the current function returns.
+    * A view of a list on the stack or of a column of a struct of arrays is copied, any other array is returned as it is.
+    */
+   llvm::Value* escapingArray(llvm::Value* array);
+
+   /*! Returns a new typed array with the elements of array. */
+   llvm::Value* copyArray(llvm::Value* array);
+
+   /*! Returns a list value, which stays valid when the current function returns.
+    * The typed arrays of the list and of its nested lists are passed through escapingArray.
+    */
+   llvm::Value* escapingList(llvm::Value* list);
+
+   /*! Converts a list (alloca or value) or a typed array into a typed array of the given type.
+    * The elements are copied, integers are converted to double if needed.
+    * \return The array value or nullptr if the value can't be converted.
+    */
+   llvm::Value* convertToArray(llvm::Value* value, llvm::Type* arrayType);
+
+   /*! Returns the pointer to the characters of a string literal. Equal literals share one constant.
+    * The characters are preceded by the header {capacity, length} like the strings created at run time.
+    */
+   llvm::Constant* getStringLiteral(const std::string& value);
+
+   /*! Returns true if the liquid type of the value is string, see getLiquidType. */
+   bool isString(llvm::Value* value) { return getLiquidType(value) == "string"; }
+
+   /*! Returns the length of a string, which is read from its header. */
+   llvm::Value* stringLength(llvm::Value* str);
+
+   /*! Returns the hash map type map<key,value>, which is created on first use.
+    * \return The type or nullptr if the key isn't one of mapKeyTypes or the value isn't one of mapValueTypes.
+    */
+   llvm::Type* getMapType(const std::string& keyTypeName, const std::string& valueTypeName);
+
+   /*! Returns true if the type is a hash map type. */
+   bool isMapType(llvm::Type* ty) const { return ty != nullptr && mapTypes.count(ty) != 0; }
+
+   /*! Returns the key type of a hash map type. */
+   llvm::Type* getMapKeyType(llvm::Type* mapType) const { return mapTypes.at(mapType).first; }
+
+   /*! Returns the value type of a hash map type. */
+   llvm::Type* getMapValueType(llvm::Type* mapType) const { return mapTypes.at(mapType).second; }
+
+   /*! Creates a new empty hash map.
+    * \return The map value {table}.
+    */
+   llvm::Value* createMap(llvm::Type* mapType);
+
+   /*! Frees the maps and the structs of arrays of the variables of a function, which own their table.
+    * A variable owns its table if it only gets new tables and its value is only used to read and to change the table.
+    * The table is freed when the variable gets a new table and when the function returns.
+    */
+   void freeTables(llvm::Function& function);
+
+   /*! Frees the typed arrays of a function, which have an owner.
+    * A variable owns its array if it only gets new arrays and its value is only used in place: read, written or
+    * passed to a function, which doesn't keep it. The array is freed when the variable gets a new one and when
+    * the function returns. A new array, which isn't assigned or returned, is freed after its last use.
+    */
+   void freeArrays(llvm::Function& function);
+
+   /*! Converts a key or a value to the key or value type of a map, an integer is taken as double.
+    * \return The converted value or nullptr if it doesn't match.
+    */
+   llvm::Value* convertMapItem(llvm::Value* item, llvm::Type* type);
+
+   /*! Calls the runtime function of a map operation specialized for the key type.
+    * The values are passed as 64 bit word, so the value is converted into a word and the result of get back.
+    * \param[in] operation One of len, get, put, contains or remove.
+    * \param[in] map       The map value.
+    * \param[in] key       The key, already converted to the key type (see convertMapItem).
+    * \param[in] value     The value of put, the default value of get (the zero value if not given).
+    * \return The result, contains and remove return a boolean.
+    */
+   llvm::Value* callMapBuiltin(const std::string& operation, llvm::Value* map, llvm::Value* key, llvm::Value* value = nullptr);
+
+   /*! Returns the type soa<klass>, a collection of objects stored column by column, which is created on first use.
+    * \return The type or nullptr if it isn't a class or an instance variable isn't an int, double or boolean.
+    */
+   llvm::Type* getSoaType(const std::string& klass);
+
+   /*! Returns true if the type is a struct of arrays type. */
+   bool isSoaType(llvm::Type* ty) const { return ty != nullptr && soaTypes.count(ty) != 0; }
+
+   /*! Returns the class of the records of a struct of arrays type. */
+   const std::string& getSoaClassName(llvm::Type* soaType) const { return soaTypes.at(soaType); }
+
+   /*! Creates a new empty struct of arrays.
+    * \return The value {table}.
+    */
+   llvm::Value* createSoa(llvm::Type* soaType);
+
+   /*! Returns the count of records of a struct of arrays. */
+   llvm::Value* soaLength(llvm::Value* soa);
+
+   /*! Returns the column of an instance variable as typed array, a view of the elements. A boolean column is an int[].
+    * \return The array value or nullptr if the class has no such instance variable.
+    */
+   llvm::Value* soaColumn(llvm::Value* soa, const std::string& member);
+
+   /*! Appends the instance variables of an object of the class as a new record. */
+   llvm::Value* soaAppend(llvm::Value* soa, llvm::Value* object);
+
+   /*! Returns a new object of the class with the instance variables of the record at index. */
+   llvm::Value* soaRecord(llvm::Value* soa, llvm::Value* index);
+
+   /*! Creates the call of a built in function in the current block. */
+   llvm::CallInst* callBuiltin(const std::string& name, std::vector<llvm::Value*> args);
+
+   /*! Enters a loop, break and continue inside jump to its targets. */
+   void pushLoop(const LoopTargets& targets)
+   {
+      loops.push_back(targets);
+      ++loopCount;
+   }
+
+   /*! Leaves the innermost loop. */
+   void popLoop() { loops.pop_back(); }
+
+   /*! Returns the innermost loop of the current function or nullptr if there is none. */
+   const LoopTargets* currentLoop();
+
+   /*! Returns true if the instructions of block are few and can't fail or have side effects,
+    * so they can be executed unconditionally instead of behind a branch.
+    */
+   static bool isSpeculatable(llvm::BasicBlock* block);
+
+   /*! Parses the option -f fast-math, which enables all fast-math flags, or -f fast-math=reassoc,contract,...
+    * which enables only the listed ones (reassoc, contract, nnan, ninf, nsz, arcp, afn).
+    * Returns false if a flag is unknown.
+    */
+   static bool parseFastMath(const std::string& option, llvm::FastMathFlags& flags);
+
+   /*! Enables the fast-math flags for the double arithmetic of a function (@fastmath). */
+   void enableFastMath(llvm::Function* function) { fastMathFunctions.insert(function); }
+
+   /*! Moves what is known of a function (@fastmath, the liquid type of its result) to the function replacing it.
+    * Is called before the function is erased, replacement is nullptr if there is none.
+    */
+   void replaceFunction(llvm::Function* function, llvm::Function* replacement);
+
+   /*! Sets the fast-math flags of the current function on value, if it is a floating point operation.
+    * A @fastmath function gets the flags of the option or all of them, if the option isn't given.
+    */
+   llvm::Value* applyFastMath(llvm::Value* value);
 
  private:
+   friend class TieredCompiler;
+
+   /*! Links the definitions of the used built ins of the runtime bitcode into the module m, so they can be inlined.
+    * Problems are written to log, the worker of the TieredCompiler must not write to the output of the script.
+    */
+   void linkRuntime(llvm::Module& m, std::ostream& log);
+
+   /*! Runs the optimizer pipeline O2 over the module m compiled for the target machine tm, problems are written to log. */
+   void optimize(llvm::Module& m, llvm::TargetMachine& tm, std::ostream& log);
+
+   /*! Maps the declarations of the built ins to their functions in the process. */
+   void mapBuiltins(llvm::ExecutionEngine& engine);
+
+   /*! Returns true if the script is compiled for latency, see CompileMode. */
+   bool isLatencyMode();
+
+   /*! Maps the math functions to the vector variants of the vectorLibrary, used by the loop vectorizer. */
+   void addVectorLibrary(llvm::TargetLibraryInfoImpl& tlii, std::ostream& log);
+
    void setCurrentBlock(llvm::BasicBlock * block) { codeBlocks.front()->setCodeBlock(block); }
 
-   /*! Setup up the built in functions and types:
-    * - printvalue
-    * - printdouble
-    * - sin
-    * - displayln
-    * - display
+   /*! Returns the suffix of the runtime functions of a map with this key type, see mapKeyTypes. */
+   std::string mapKeySuffix(llvm::Type* keyType);
+
+   /*! Setup up the built in types and functions.
+    * The functions are declared with the attributes of the builtinFunctions table and mapped by name when run.
     */
    void setupBuiltIns();
 
@@ -260,16 +594,20 @@ public:
    std::string              klassName;              ///< The current class definition block
    llvm::Function*          mainFunction{nullptr};  ///< main function
    llvm::Module*            module{nullptr};        ///< llvm module ...
+   std::unique_ptr<llvm::TargetMachine> targetMachine; ///< The host CPU, the code is optimized and compiled for.
+   std::unique_ptr<TieredCompiler> tiered;          ///< Optimizes the hot functions while the script runs (-m tiered).
    llvm::LLVMContext        llvmContext;            ///< and context
    KlassAttributes          classAttributes;        ///< List of attributes a class
    KlassInitCode            classInitCode;          ///< The init code (statements) for each class
    std::map<std::string, llvm::Type*> classTypeMap; ///< Maps a class name to its LLVM struct type
+   llvm::ValueMap<const llvm::Value*, std::string>              liquidTypes;      ///< The recorded liquid types, see setLiquidType
+   llvm::ValueMap<const llvm::Value*, std::vector<std::string>> listElementTypes; ///< The liquid types of the elements of the lists
    int                      errors{0};              ///< Count of errors while code gen.
    ScopeType                currentScopeType{ScopeType::CodeBlock};
    std::ostream&            outs;
    struct buildin_info_t {
-      llvm::Function* f{nullptr};
-      void*           addr{nullptr};
+      std::string name;
+      void*       addr{nullptr};
    };
    std::vector<buildin_info_t> builtins;
    llvm::Type* intType {nullptr};
@@ -278,8 +616,20 @@ public:
    llvm::Type* boolType {nullptr};
    llvm::Type* voidType {nullptr};
    llvm::Type* varType {nullptr};
+   llvm::Type* intArrayType {nullptr};
+   llvm::Type* doubleArrayType {nullptr};
    std::map<std::string, llvm::Type*> llvmTypeMap;
+   std::map<std::string, llvm::Constant*> stringLiterals; ///< The interned string literals
+   std::map<llvm::Type*, std::pair<llvm::Type*, llvm::Type*>> mapTypes; ///< The key and value type of the hash map types
+   std::map<llvm::Type*, std::string> soaTypes;     ///< The class of the struct of arrays types
+   llvm::StructType* soaTableType {nullptr};        ///< The header of the runtime table of a struct of arrays
    std::map<std::string, FunctionDeclaration*> templatedFunctionDeclarations;
+   CallTargets                                 callTargets; ///< The functions by name, receiver class and arity
+   std::vector<LoopTargets>                    loops;       ///< The loops being generated, the innermost last
+   std::set<llvm::Function*>                   fastMathFunctions; ///< The @fastmath functions
+   std::set<llvm::AllocaInst*>                 stackViews;        ///< The typed array variables, which may view a list on the stack
+   int                                         loopCount{0};      ///< The number of generated loops
+   bool                                        latencyMode{false}; ///< The compile mode chosen by generateCode
    bool generateTemplatedFunction {false};
 };
 
@@ -18,6 +18,14 @@ Value* CompOperator::codeGen(CodeGenContext& context)
    Value* lhsVal = lhs->codeGen(context);
    if (lhsVal == nullptr)
       return nullptr;
+   if (!context.getObjectClassName(lhsVal).empty() || !context.getObjectClassName(rhsVal).empty()) {
+      Node::printError("Class objects can't be compared.");
+      context.addError();
+      return nullptr;
+   }
+   if (context.isString(lhsVal) && context.isString(rhsVal)) {
+      return codeGenStringCompare(lhsVal, rhsVal, context);
+   }
    if ((lhsVal->getType() != Type::getDoubleTy(context.getGlobalContext())) && (lhsVal->getType() != context.getGenericIntegerType())) {
       Node::printError("Left hand side of compare expression isn't a value type (number)");
       context.addError();
@@ -65,7 +73,38 @@ Value* CompOperator::codeGen(CodeGenContext& context)
          return nullptr;
    }
 
-   return CmpInst::Create(oinstr, predicate, lhsVal, rhsVal, "cmptmp", context.currentBlock());
+   return context.applyFastMath(CmpInst::Create(oinstr, predicate, lhsVal, rhsVal, "cmptmp", context.currentBlock()));
+}
+
+Value* CompOperator::codeGenStringCompare(Value* lhsVal, Value* rhsVal, CodeGenContext& context)
+{
+   auto zero = ConstantInt::get(context.getGenericIntegerType(), 0);
+   if (op == TCEQ || op == TCNE) {
+      // The equality test doesn't look at the characters if the lengths differ.
+      auto equal = context.callBuiltin("liq_str_equal", {lhsVal, rhsVal});
+      return CmpInst::Create(Instruction::ICmp, op == TCEQ ? CmpInst::ICMP_NE : CmpInst::ICMP_EQ, equal, zero, "cmptmp", context.currentBlock());
+   }
+   CmpInst::Predicate predicate;
+   switch (op) {
+      case TCGE:
+         predicate = CmpInst::ICMP_SGE;
+         break;
+      case TCGT:
+         predicate = CmpInst::ICMP_SGT;
+         break;
+      case TCLT:
+         predicate = CmpInst::ICMP_SLT;
+         break;
+      case TCLE:
+         predicate = CmpInst::ICMP_SLE;
+         break;
+      default:
+         Node::printError("Unknown compare operator.");
+         context.addError();
+         return nullptr;
+   }
+   auto order = context.callBuiltin("liq_str_compare", {lhsVal, rhsVal});
+   return CmpInst::Create(Instruction::ICmp, predicate, order, zero, "cmptmp", context.currentBlock());
 }
 
 std::string CompOperator::toString()
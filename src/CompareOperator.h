@@ -25,6 +25,9 @@ public:
    Expression* getRHS() { return rhs; }
 
 private:
+   /*! Compares two strings, the order is the one of strcmp. */
+   llvm::Value* codeGenStringCompare(llvm::Value* lhsVal, llvm::Value* rhsVal, CodeGenContext& context);
+
    int         op{0};
    Expression* lhs{nullptr};
    Expression* rhs{nullptr};
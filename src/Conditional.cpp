@@ -18,6 +18,9 @@ Conditional::~Conditional()
 
 Value* Conditional::codeGen(CodeGenContext& context)
 {
+   if (isExpression) {
+      return codeGenExpression(context);
+   }
    Value* comp = cmpOp->codeGen(context);
    if (comp == nullptr) {
       Node::printError("Code generation for compare operator of the conditional statement failed.");
@@ -72,4 +75,86 @@ Value* Conditional::codeGen(CodeGenContext& context)
    return mergeBlock; // dummy return, for now
 }
 
+Value* Conditional::codeGenExpression(CodeGenContext& context)
+{
+   Value* comp = cmpOp->codeGen(context);
+   if (comp == nullptr) {
+      return nullptr;
+   }
+   if (!comp->getType()->isIntegerTy(1)) {
+      Node::printError(location, "The condition of a conditional expression must be a boolean expression.");
+      context.addError();
+      return nullptr;
+   }
+
+   Function*   function   = context.currentBlock()->getParent();
+   BasicBlock* condBlock  = context.currentBlock();
+   BasicBlock* thenBlock  = BasicBlock::Create(context.getGlobalContext(), "then_value", function);
+   BasicBlock* elseBlock  = BasicBlock::Create(context.getGlobalContext(), "else_value");
+   BasicBlock* mergeBlock = BasicBlock::Create(context.getGlobalContext(), "merge_value");
+
+   // Each branch ends in its own block, which may differ from the one it started in (e.g. a nested and/or).
+   context.setInsertPoint(thenBlock);
+   Value*      thenValue = thenExpr->codeGen(context);
+   BasicBlock* thenEnd   = context.currentBlock();
+   function->insert(function->end(), elseBlock);
+   context.setInsertPoint(elseBlock);
+   Value*      elseValue = elseExpr->codeGen(context);
+   BasicBlock* elseEnd   = context.currentBlock();
+   if (thenValue == nullptr || elseValue == nullptr) {
+      delete mergeBlock;
+      return nullptr;
+   }
+
+   auto thenType = thenValue->getType();
+   auto elseType = elseValue->getType();
+   if (thenType != elseType && (thenType->isDoubleTy() || elseType->isDoubleTy()) && (thenType->isIntegerTy(64) || elseType->isIntegerTy(64))) {
+      // Like a binary operation, an int is taken as double if the other branch is a double.
+      auto doubleTy = Type::getDoubleTy(context.getGlobalContext());
+      if (thenType->isIntegerTy()) {
+         thenValue = new SIToFPInst(thenValue, doubleTy, "castdb", thenEnd);
+      } else {
+         elseValue = new SIToFPInst(elseValue, doubleTy, "castdb", elseEnd);
+      }
+   }
+   if (thenValue->getType() != elseValue->getType() || thenValue->getType()->isVoidTy() || isa<AllocaInst>(thenValue)) {
+      Node::printError(location, "Both branches of a conditional expression must have the same type, but they are " + context.typeNameOf(thenType) + " and " + context.typeNameOf(elseType) + ".");
+      context.addError();
+      delete mergeBlock;
+      return nullptr;
+   }
+   // A string and an object, or objects of different classes, are all pointers.
+   auto liquidType = context.getLiquidType(thenValue);
+   if (thenType->isPointerTy() && liquidType != context.getLiquidType(elseValue)) {
+      Node::printError(location, "Both branches of a conditional expression must have the same type, but they are " + liquidType + " and " + context.getLiquidType(elseValue) + ".");
+      context.addError();
+      delete mergeBlock;
+      return nullptr;
+   }
+
+   if (thenEnd == thenBlock && elseEnd == elseBlock && context.isSpeculatable(thenBlock) && context.isSpeculatable(elseBlock)) {
+      // Both branches are cheap and can't fail, so both are evaluated and the value is selected without a branch.
+      delete mergeBlock;
+      condBlock->splice(condBlock->end(), thenBlock);
+      condBlock->splice(condBlock->end(), elseBlock);
+      thenBlock->eraseFromParent();
+      elseBlock->eraseFromParent();
+      context.setInsertPoint(condBlock);
+      auto result = SelectInst::Create(comp, thenValue, elseValue, "cond_value", condBlock);
+      context.setLiquidType(result, liquidType);
+      return result;
+   }
+
+   BranchInst::Create(thenBlock, elseBlock, comp, condBlock);
+   BranchInst::Create(mergeBlock, thenEnd);
+   BranchInst::Create(mergeBlock, elseEnd);
+   function->insert(function->end(), mergeBlock);
+   context.setInsertPoint(mergeBlock);
+   auto result = PHINode::Create(thenValue->getType(), 2, "cond_value", mergeBlock);
+   result->addIncoming(thenValue, thenEnd);
+   result->addIncoming(elseValue, elseEnd);
+   context.setLiquidType(result, liquidType);
+   return result;
+}
+
 } // namespace liquid
@@ -4,18 +4,23 @@
 namespace liquid
 {
 
-/*! Represents a conditional statement. */
+/*! Represents a conditional statement or the conditional expression `if cond then a else b`. */
 class Conditional : public Statement
 {
 public:
    explicit Conditional(Expression* op, Expression* thenExpr, Expression* elseExpr = nullptr) : cmpOp((CompOperator*)op), thenExpr(thenExpr), elseExpr(elseExpr)
    {
    }
+   /*! The conditional expression, its value is the one of the taken branch. */
+   Conditional(Expression* op, Expression* thenExpr, Expression* elseExpr, YYLTYPE loc)
+      : cmpOp((CompOperator*)op), thenExpr(thenExpr), elseExpr(elseExpr), location(loc), isExpression(true)
+   {
+   }
    virtual ~Conditional();
 
    llvm::Value* codeGen(CodeGenContext& context) override;
    NodeType     getType() override { return NodeType::expression; }
-   std::string  toString() override { return "conditional "; }
+   std::string  toString() override { return isExpression ? "conditional expression " : "conditional "; }
    void         Accept(Visitor& v) override { v.VisitConditional(this); }
 
    CompOperator* getCompOperator() { return cmpOp; }
@@ -23,9 +28,13 @@ public:
    Expression*   getElse() { return elseExpr; }
 
 private:
+   llvm::Value* codeGenExpression(CodeGenContext& context);
+
    CompOperator* cmpOp{nullptr};
    Expression*   thenExpr{nullptr};
    Expression*   elseExpr{nullptr};
+   YYLTYPE       location;
+   bool          isExpression{false};
 };
 
 } // namespace liquid
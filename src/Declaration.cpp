@@ -22,26 +22,49 @@ namespace liquid {
 Value* VariableDeclaration::codeGen(CodeGenContext& context)
 {
     Value* val = nullptr;
-    if( context.findVariable(id->getName()) ) {
+    if( !annotations.empty() ) {
+        // The annotations of an instance variable are handled by the class declaration.
+        Node::printError(location, " annotation @" + annotations.front() + " isn't valid for variable '" + id->getName() + "'");
+        context.addError();
+        return nullptr;
+    }
+    if( context.findVariable(id->getName()) || context.findImmutable(id->getName()) ) {
         Node::printError(location, " variable '" + id->getName()  + "' already exist\n");
         context.addError();
         return nullptr;
     }
 
     Type* ty = context.typeOf(*type);
+    if( ty->isVoidTy() && type->getName().compare( 0, 4, "soa<" ) == 0 ) {
+        Node::printError(location, " the instance variables of a class in " + type->getName() + " must be of type int, double or boolean");
+        context.addError();
+        return nullptr;
+    }
+    if( context.isImmutableScalar(*this, ty) && !parameter ) {
+        return codeGenImmutable(context, ty);
+    }
     if( ty->isStructTy() && ty->getStructName() == "var" ) {
        // It is a var declaration, postpone type until assignment.
        context.locals()[id->getName()] = nullptr;
-    } else if( ty->isStructTy() && context.getScopeType() != ScopeType::FunctionDeclaration ) {
-        // It is really a declaration of a class type which we put always onto the heap.
-        AllocaInst* alloc = new AllocaInst(ty, 0, id->getName().c_str(), context.currentBlock());
+    } else if( ty->isStructTy() && !context.isArrayType(ty) && !context.isMapType(ty) && !context.isSoaType(ty) && !parameter ) {
+        // It is really a declaration of a class type, the variable refers to an object on the heap.
+        // The optimizer moves the object onto the stack, if it doesn't leave the function.
+        AllocaInst* alloc = new AllocaInst(PointerType::get(ty, 0), 0, id->getName().c_str(), context.currentBlock());
         context.locals()[id->getName()] = alloc;
         val = alloc;
-        context.varStruct = val; // Indicates that a variable of a class is declared
+        if( assignmentExpr == nullptr ) {
+            // The variable gets nothing assigned, so a new object is initialized by the constructor of the class.
+            Value* object = context.createObject(ty);
+            new StoreInst(object, alloc, context.currentBlock());
+            Function* fn = context.findCallTarget("__construct", type->getName(), 0);
+            if( fn != nullptr ) {
+                CallInst::Create(fn, {object}, "", context.currentBlock());
+            }
+        }
     }
     else
     {
-        if( ty->isStructTy() ) {
+        if( ty->isStructTy() && !context.isArrayType(ty) && !context.isMapType(ty) && !context.isSoaType(ty) ) {
             // It is a declaration of a class type in a function declaration as a formal parameter.
             // Therefor a pointer reference is needed.
             ty = PointerType::get(ty,0);
@@ -49,8 +72,25 @@ Value* VariableDeclaration::codeGen(CodeGenContext& context)
         AllocaInst* alloc = new AllocaInst(ty, 0, id->getName().c_str(), context.currentBlock());
         context.locals()[id->getName()] = alloc;
         val = alloc;
+        if( context.isArrayType(ty) && parameter ) {
+            // The argument may be a view of a list of the caller.
+            context.addStackView(alloc);
+        }
+        if( context.isArrayType(ty) && assignmentExpr == nullptr && !parameter ) {
+            // An array without initializer is empty.
+            new StoreInst(Constant::getNullValue(ty), alloc, context.currentBlock());
+        }
+        if( context.isMapType(ty) && assignmentExpr == nullptr && !parameter ) {
+            // A map without initializer gets a new empty table.
+            new StoreInst(context.createMap(ty), alloc, context.currentBlock());
+        }
+        if( context.isSoaType(ty) && assignmentExpr == nullptr && !parameter ) {
+            // A struct of arrays without initializer has no records.
+            new StoreInst(context.createSoa(ty), alloc, context.currentBlock());
+        }
     }
     context.setVarType(type->getName(), id->getName());
+    context.setLiquidType(val, type->getName());
     
     if (assignmentExpr != nullptr) {
         Assignment assn(id, assignmentExpr, location);
@@ -59,27 +99,33 @@ Value* VariableDeclaration::codeGen(CodeGenContext& context)
         id = nullptr;
         assignmentExpr = nullptr;
     }
-    else if ( context.varStruct )
-    {
-        // The variable gets nothing assigned so 
-        // auto assign defaults (member assignments) on classes ctor call.
-        auto stmts = context.getKlassInitCode(type->getName());
-        for ( auto assign : stmts )
-        {
-            assign->codeGen( context );
-        }
+    return val;
+}
 
-        // Generate function call to the ctor, if exists.
-        Function *fn = context.getModule()->getFunction( "__init__%" + type->getName() );
-        if ( fn != nullptr )
-        {
-            std::vector<Value*> args;
-            args.push_back( context.varStruct );
-            (void) CallInst::Create(fn, args, "", context.currentBlock());
+/*! The variable is never assigned, so it doesn't need a stack slot. Its name refers to the value of the initializer. */
+Value* VariableDeclaration::codeGenImmutable(CodeGenContext& context, Type* ty)
+{
+    Value* value = Constant::getNullValue( ty );
+    if( assignmentExpr != nullptr ) {
+        value = assignmentExpr->codeGen( context );
+        if( value == nullptr ) {
+            Node::printError( location, " Assignment expression results in nothing" );
+            context.addError();
+            return nullptr;
         }
-        context.varStruct = nullptr;
     }
-    return val;
+    if( value->getType() != ty ) {
+        if( value->getType()->getTypeID() != ty->getTypeID() ) {
+            Node::printError( location, " Assignment of incompatible types, " + id->getName() + " is a " + context.typeNameOf( ty ) + "." );
+            context.addError();
+            return nullptr;
+        }
+        // A boolean assigned to an int and vice versa, like Assignment does it.
+        value = CastInst::CreateIntegerCast( value, ty, false, "cast", context.currentBlock() );
+    }
+    context.addImmutable( id->getName(), value );
+    context.setVarType( type->getName(), id->getName() );
+    return value;
 }
 
 }
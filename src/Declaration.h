@@ -45,12 +45,21 @@ public:
    bool              hasAssignmentExpr() const { return assignmentExpr != nullptr; }
    Expression*       getAssignment() const { return assignmentExpr; }
    YYLTYPE&          getLocation() { return location; }
+   /*! Marks the declaration as formal parameter of a function, its value comes from the caller. */
+   void              setParameter() { parameter = true; }
+   /*! Marks the variable as assigned after its declaration, see VisitorAssignedVariables. */
+   void              setAssigned() { assigned = true; }
+   bool              isAssigned() const { return assigned; }
 
 protected:
+   llvm::Value* codeGenImmutable(CodeGenContext& context, llvm::Type* ty);
+
    Identifier* type{nullptr};
    Identifier* id{nullptr};
    Expression* assignmentExpr{nullptr};
    YYLTYPE     location;
+   bool        parameter{false};
+   bool        assigned{false};
 };
 
 } // namespace liquid
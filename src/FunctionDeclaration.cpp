@@ -1,9 +1,12 @@
 #include <typeinfo>
+#include <set>
 
 #if defined(_MSC_VER)
 #pragma warning( push , 0 )
 #endif
 
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 
 #if defined(_MSC_VER)
@@ -20,6 +23,81 @@ using namespace llvm;
 
 namespace liquid {
 
+namespace {
+/*! Number of entries of the result cache of a @memo function, a power of two. */
+constexpr uint64_t memoCacheSize = 4096;
+
+/*! Returns the name of a function with side effects called by function (or its callees) or an empty string.
+ *  A builtin without side effects is marked with willreturn, one that only stops the script at an error
+ *  with argmemonly.
+ */
+std::string findSideEffect( Function* function, std::set<Function*>& visited )
+{
+    if( !visited.insert( function ).second ) {
+        return "";
+    }
+    for( auto& instr : instructions( function ) ) {
+        auto call = dyn_cast<CallBase>( &instr );
+        if( call == nullptr ) {
+            continue;
+        }
+        auto callee = call->getCalledFunction();
+        if( callee == nullptr ) {
+            return "an unknown function";
+        }
+        if( callee->isIntrinsic() ) {
+            continue;
+        }
+        if( callee->isDeclaration() ) {
+            if( !callee->willReturn() && !callee->onlyAccessesArgMemory() ) {
+                // display and displayln are generated as calls of the liq_write functions.
+                return callee->getName().starts_with( "liq_write" ) ? "display" : callee->getName().str();
+            }
+            continue;
+        }
+        auto found = findSideEffect( callee, visited );
+        if( !found.empty() ) {
+            return found;
+        }
+    }
+    return "";
+}
+
+/*! Returns true if the address of a stack variable of the function may be passed on,
+ *  i.e. it is used other than for loading and storing the variable.
+ */
+bool stackEscapes( Function* function )
+{
+    for( auto& instr : instructions( function ) ) {
+        if( !isa<AllocaInst>( instr ) ) {
+            continue;
+        }
+        SmallVector<Value*, 8> pointers{ &instr };
+        while( !pointers.empty() ) {
+            auto pointer = pointers.pop_back_val();
+            for( auto& use : pointer->uses() ) {
+                auto user = use.getUser();
+                if( isa<LoadInst>( user ) ) {
+                    continue;
+                }
+                if( auto store = dyn_cast<StoreInst>( user ) ) {
+                    if( store->getValueOperand() == pointer ) {
+                        return true;
+                    }
+                    continue;
+                }
+                if( isa<GetElementPtrInst>( user ) ) {
+                    pointers.push_back( user );
+                    continue;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+}
+
 
 FunctionDeclaration::FunctionDeclaration(const FunctionDeclaration& other)
 {
@@ -28,9 +106,13 @@ FunctionDeclaration::FunctionDeclaration(const FunctionDeclaration& other)
    arguments = new VariableList();
    for( auto arg : *other.arguments ) {
       arguments->push_back(new VariableDeclaration(new Identifier(arg->getVariablenTypeName(), arg->getLocation()), new Identifier(arg->getVariablenName(), arg->getLocation()), arg->getLocation()));
+      if( arg->isAssigned() ) {
+         arguments->back()->setAssigned();
+      }
    }
    block = other.block;
    location = other.location;
+   annotations = other.annotations;
    isaCopy = true; // Quick hack, a copy contains the origin block and shouldn't be deleted.
 }
 
@@ -75,6 +157,9 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
       context.addTemplateFunction( id->getName(), this );
       return nullptr;
    }
+   if( !checkAnnotations( context ) ) {
+      return nullptr;
+   }
 
    vector<Type*> argTypes;
     if( !context.getKlassName().empty() ) {
@@ -85,14 +170,18 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
 
     for( auto varDecl : *arguments ) {
         Type* ty = context.typeOf( varDecl->getIdentifierOfVariablenType() );
-        if( ty->isStructTy() ) {
+        if( ty->isStructTy() && !context.isArrayType( ty ) && !context.isMapType( ty ) && !context.isSoaType( ty ) ) {
             ty = PointerType::get( ty, 0 );
         }
         argTypes.push_back( ty );
     }
 
-    // TODO check return type if it is a structure type !!! May be it should be a ptr to the structure!
-    FunctionType *ftype = FunctionType::get( context.typeOf( *type ), argTypes, false );
+    Type* returnTy = context.typeOf( *type );
+    if( context.isClass( type->getName() ) ) {
+        // An object is returned by its pointer, it is on the heap.
+        returnTy = PointerType::get( returnTy, 0 );
+    }
+    FunctionType *ftype = FunctionType::get( returnTy, argTypes, false );
     std::string functionName = id->getName();
     if( type->getName() == "var" ) {
         functionName += "_del";
@@ -101,6 +190,17 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
         functionName += "%" + context.getKlassName();
     }
     Function *function = Function::Create( ftype, GlobalValue::InternalLinkage, functionName.c_str(), context.getModule() );
+    // The calling convention, which guarantees the tail calls.
+    function->setCallingConv( CallingConv::Tail );
+    if( hasAnnotation( "fastmath" ) ) {
+        context.enableFastMath( function );
+    }
+    if( type->getName() != "var" ) {
+        // The liquid type of the result, e.g. a string and an object are both returned as pointer.
+        context.setLiquidType( function, type->getName() );
+        // Known before the body, so the function can call itself.
+        addCallTargets( context, function );
+    }
     BasicBlock *bblock = BasicBlock::Create( context.getGlobalContext(), "entry", function, 0 );
     context.newScope( bblock, ScopeType::FunctionDeclaration );
 
@@ -115,10 +215,21 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
         AllocaInst* alloca = new AllocaInst( self_ptr_ty, 0, "self_addr", context.currentBlock() );
         new StoreInst( &(*actualArgs) /*ptr_this*/, alloca, context.currentBlock() );
         context.locals()["self"] = alloca;
+        context.setLiquidType( alloca, context.getKlassName() );
         ++actualArgs;
     }
     // Now the remaining arguments
     for( auto varDecl : *arguments ) {
+        varDecl->setParameter();
+        std::string argName = varDecl->getVariablenName();
+        if( context.isImmutableScalar( *varDecl, context.typeOf( varDecl->getIdentifierOfVariablenType() ) ) ) {
+            // A parameter, which is never assigned, is the argument itself.
+            actualArgs->setName( argName );
+            context.addImmutable( argName, &(*actualArgs) );
+            context.setVarType( varDecl->getVariablenTypeName(), argName );
+            ++actualArgs;
+            continue;
+        }
         AllocaInst* alloca = llvm::dyn_cast< AllocaInst >(varDecl->codeGen( context ));
         std::string valName = varDecl->getVariablenName();
         // TODO a struct is coming as struct alloca, but needed to be a pointer to a struct alloca.
@@ -153,6 +264,13 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
     if( context.currentBlock()->getTerminator() == nullptr ) {
         if( type->getName() == "var" && !retTy->isVoidTy() ) {
             // Generate one according to the value of the function body.
+            auto list = dyn_cast<AllocaInst>( blockValue );
+            if( list != nullptr && list->getAllocatedType()->isStructTy() ) {
+                // A list is returned by value, the alloca is gone after the return.
+                blockValue = new LoadInst( list->getAllocatedType(), list, "ret_list", context.currentBlock() );
+            }
+            // Like a return statement, a view of a list on the stack is copied.
+            blockValue = context.isArrayType( blockValue->getType() ) ? context.escapingArray( blockValue ) : context.escapingList( blockValue );
             ReturnInst::Create( context.getGlobalContext(), blockValue, context.currentBlock() );
         } else {
             // Or a ret void.
@@ -187,6 +305,7 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
            auto fct = context.getModule()->getFunction(constructedFctName);
            if( fct != nullptr ) {
               // Yes, take that one and remove the newly generated.
+              context.replaceFunction( function, nullptr );
               function->eraseFromParent();
               context.endScope();
               return fct;
@@ -200,6 +319,10 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
         }
 
         Function *functionNew = Function::Create( ftypeNew, GlobalValue::InternalLinkage, functionNameNew, context.getModule() );
+        functionNew->setCallingConv( CallingConv::Tail );
+        if( retval != nullptr ) {
+            context.setLiquidType( functionNew, context.getLiquidType( retval ) );
+        }
 
         // Create a value map for all arguments to be mapped to the new function.
         ValueToValueMapTy VMap;
@@ -215,15 +338,206 @@ Value* FunctionDeclaration::codeGen( CodeGenContext& context )
         CloneFunctionInto( functionNew, function, VMap, CloneFunctionChangeType::LocalChangesOnly, Returns );
 
         // Remove the old one.
+        context.replaceFunction( function, functionNew );
         function->eraseFromParent();
 
         function = functionNew;
+        addCallTargets( context, function );
+    }
+
+    context.freeTables( *function );
+    context.freeArrays( *function );
+    markTailCalls( context, function );
+    if( hasAnnotation( "memo" ) ) {
+        function = memoize( context, function );
     }
 
     context.endScope();
     return function;
 }
 
+/*! Makes the calls of liquid functions, whose result is returned at once, to guaranteed tail calls.
+ *  So a recursion doesn't need stack, even if the optimizer is off.
+ *  A tail call isn't possible, if the function passes the address of one of its variables, e.g. a list,
+ *  if the result is converted to the return type of the function or if an array passed to the call is freed after it.
+ *  These are reported as a warning.
+ */
+void FunctionDeclaration::markTailCalls( CodeGenContext& context, Function* function )
+{
+    auto warn = [&]( CallInst* call, const std::string& reason ) {
+        Node::printError( location, " Warning: The call of " + call->getCalledFunction()->getName().str() + "(...) in " + id->getName()
+                                        + "(...) is not in tail position, " + reason + "." );
+    };
+    std::vector<CallInst*> calls;
+    for( auto& bb : *function ) {
+        auto ret = dyn_cast<ReturnInst>( bb.getTerminator() );
+        if( ret == nullptr || ret->getReturnValue() == nullptr ) {
+            continue;
+        }
+        // Look through the conversion of the result to the return type, e.g. an int returned as double.
+        auto value = ret->getReturnValue();
+        bool converted = false;
+        for( ;; ) {
+            auto cmp = dyn_cast<ICmpInst>( value );
+            if( cmp != nullptr ) {
+                // An int returned as boolean is compared with 0.
+                auto zero = dyn_cast<ConstantInt>( cmp->getOperand( 1 ) );
+                if( cmp->getPredicate() != ICmpInst::ICMP_NE || zero == nullptr || !zero->isZero() ) {
+                    break;
+                }
+            }
+            if( cmp == nullptr && !isa<CastInst>( value ) ) {
+                break;
+            }
+            value = cast<Instruction>( value )->getOperand( 0 );
+            converted = true;
+        }
+        auto call = dyn_cast<CallInst>( value );
+        if( call == nullptr || call->getParent() != &bb || call->getCallingConv() != CallingConv::Tail ) {
+            continue;
+        }
+        // An array passed to the call is freed after it, see CodeGenContext::freeArrays.
+        auto next = call->getNextNode();
+        while( isa<CallInst>( next ) && cast<CallInst>( next )->getCalledFunction() != nullptr
+               && cast<CallInst>( next )->getCalledFunction()->getName() == "liq_array_free" ) {
+            next = next->getNextNode();
+        }
+        if( converted ) {
+            warn( call, "the result is converted to " + context.typeNameOf( function->getReturnType() ) );
+        } else if( next == ret && call->getNextNode() != ret ) {
+            warn( call, "the array passed to it is freed after the call" );
+        } else if( next == ret ) {
+            calls.push_back( call );
+        }
+    }
+    if( calls.empty() ) {
+        return;
+    }
+    if( stackEscapes( function ) ) {
+        for( auto call : calls ) {
+            warn( call, "the function passes a reference to one of its variables" );
+        }
+        return;
+    }
+    for( auto call : calls ) {
+        call->setTailCallKind( CallInst::TCK_MustTail );
+    }
+}
+
+bool FunctionDeclaration::checkAnnotations( CodeGenContext& context )
+{
+    static const std::set<std::string> known = { "memo", "fastmath" };
+    bool valid = true;
+    for( auto& name : annotations ) {
+        if( known.count( name ) == 0 ) {
+            Node::printError( location, " Unknown annotation @" + name + " of function " + id->getName() + "(...)" );
+            context.addError();
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+/*! Puts a cache of the results in front of the function.
+ *  The cache is a direct mapped table indexed by the hash of the arguments, an entry is replaced by a
+ *  newer result with the same index. The recursive calls of the function go through the cache too.
+ */
+Function* FunctionDeclaration::memoize( CodeGenContext& context, Function* body )
+{
+    auto& llvmContext = context.getGlobalContext();
+    auto isScalar = []( Type* ty ) { return ty->isIntegerTy() || ty->isDoubleTy(); };
+    auto fnType = body->getFunctionType();
+    bool scalar = isScalar( fnType->getReturnType() );
+    for( auto param : fnType->params() ) {
+        scalar = scalar && isScalar( param );
+    }
+    if( !context.getKlassName().empty() ) {
+        Node::printError( location, " @memo method " + context.getKlassName() + "::" + id->getName() + "(...) can't be memoized, only functions" );
+        context.addError();
+        return body;
+    }
+    if( !scalar || fnType->getNumParams() == 0 ) {
+        Node::printError( location, " @memo function " + id->getName() + "(...) must have parameters and a result of type int, double or boolean" );
+        context.addError();
+        return body;
+    }
+    std::set<Function*> visited;
+    auto sideEffect = findSideEffect( body, visited );
+    if( !sideEffect.empty() ) {
+        Node::printError( location, " @memo function " + id->getName() + "(...) calls " + sideEffect + ", which has side effects" );
+        context.addError();
+        return body;
+    }
+
+    // The cache entry: used flag, the arguments as words and the result.
+    auto wordTy = Type::getInt64Ty( llvmContext );
+    auto keysTy = ArrayType::get( wordTy, fnType->getNumParams() );
+    auto entryTy = StructType::get( llvmContext, { Type::getInt1Ty( llvmContext ), keysTy, fnType->getReturnType() } );
+    auto cacheTy = ArrayType::get( entryTy, memoCacheSize );
+    auto cache = new GlobalVariable( *context.getModule(), cacheTy, false, GlobalValue::InternalLinkage, Constant::getNullValue( cacheTy ), body->getName() + ".memo" );
+
+    auto memo = Function::Create( fnType, GlobalValue::InternalLinkage, "", context.getModule() );
+    memo->setCallingConv( body->getCallingConv() );
+    memo->takeName( body );
+    body->setName( memo->getName() + ".body" );
+    body->replaceAllUsesWith( memo );
+
+    auto entryBlock = BasicBlock::Create( llvmContext, "entry", memo );
+    auto hitBlock = BasicBlock::Create( llvmContext, "hit", memo );
+    auto missBlock = BasicBlock::Create( llvmContext, "miss", memo );
+    IRBuilder<> builder( entryBlock );
+
+    std::vector<Value*> args;
+    std::vector<Value*> keys;
+    Value* hash = ConstantInt::get( wordTy, 0 );
+    for( auto& arg : memo->args() ) {
+        args.push_back( &arg );
+        auto key = arg.getType()->isDoubleTy() ? builder.CreateBitCast( &arg, wordTy ) : builder.CreateZExt( &arg, wordTy );
+        keys.push_back( key );
+        hash = builder.CreateMul( builder.CreateXor( hash, key ), ConstantInt::get( wordTy, 0x9e3779b97f4a7c15ull ) );
+    }
+    auto index = builder.CreateLShr( hash, 64 - Log2_64( memoCacheSize ), "index" );
+    auto entry = builder.CreateInBoundsGEP( cacheTy, cache, { builder.getInt64( 0 ), index }, "entry" );
+    auto usedAddr = builder.CreateStructGEP( entryTy, entry, 0 );
+    auto keysAddr = builder.CreateStructGEP( entryTy, entry, 1 );
+    auto valueAddr = builder.CreateStructGEP( entryTy, entry, 2 );
+    Value* hit = builder.CreateLoad( builder.getInt1Ty(), usedAddr, "used" );
+    for( unsigned i = 0; i < keys.size(); ++i ) {
+        auto keyAddr = builder.CreateConstInBoundsGEP2_64( keysTy, keysAddr, 0, i );
+        hit = builder.CreateAnd( hit, builder.CreateICmpEQ( builder.CreateLoad( wordTy, keyAddr ), keys[i] ) );
+    }
+    builder.CreateCondBr( hit, hitBlock, missBlock );
+
+    builder.SetInsertPoint( hitBlock );
+    builder.CreateRet( builder.CreateLoad( fnType->getReturnType(), valueAddr, "cached" ) );
+
+    builder.SetInsertPoint( missBlock );
+    auto result = builder.CreateCall( body, args, "result" );
+    result->setCallingConv( body->getCallingConv() );
+    builder.CreateStore( builder.getTrue(), usedAddr );
+    for( unsigned i = 0; i < keys.size(); ++i ) {
+        builder.CreateStore( keys[i], builder.CreateConstInBoundsGEP2_64( keysTy, keysAddr, 0, i ) );
+    }
+    builder.CreateStore( result, valueAddr );
+    builder.CreateRet( result );
+
+    addCallTargets( context, memo );
+    return memo;
+}
+
+void FunctionDeclaration::addCallTargets( CodeGenContext& context, Function* function )
+{
+    if( context.codeGenTheTemplatedFunction() ) {
+        // An instance of a template function is found by its parameter types.
+        return;
+    }
+    context.addCallTarget( id->getName(), context.getKlassName(), function );
+    if( context.getKlassName().empty() && !arguments->empty() && context.isClass( arguments->front()->getVariablenTypeName() ) ) {
+        // A function with a class object as first parameter can be called as method of the object.
+        context.addCallTarget( id->getName(), arguments->front()->getVariablenTypeName(), function );
+    }
+}
+
 std::string FunctionDeclaration::toString()
 {
    std::stringstream s;
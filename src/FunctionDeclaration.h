@@ -27,6 +27,10 @@ public:
 private:
    void checkForTemplateParameter();
    std::string buildFunctionName(llvm::Type* retType, std::vector<llvm::Type*> argTypes);
+   void addCallTargets(CodeGenContext& context, llvm::Function* function);
+   void markTailCalls(CodeGenContext& context, llvm::Function* function);
+   bool checkAnnotations(CodeGenContext& context);
+   llvm::Function* memoize(CodeGenContext& context, llvm::Function* function);
    friend class ClassDeclaration;
    Identifier* type {nullptr};
    Identifier* id {nullptr};
@@ -0,0 +1,27 @@
+#include "LoopControl.h"
+#include "CodeGenContext.h"
+#include "parser.hpp"
+
+using namespace llvm;
+
+namespace liquid
+{
+
+Value* LoopControl::codeGen(CodeGenContext& context)
+{
+   auto loop = context.currentLoop();
+   if (loop == nullptr) {
+      Node::printError(location, toString() + "outside of a loop.");
+      context.addError();
+      return nullptr;
+   }
+   // break leaves the loop without its else block, continue goes on with the next check of the condition.
+   return BranchInst::Create(token == TBREAK ? loop->exit : loop->latch, context.currentBlock());
+}
+
+std::string LoopControl::toString()
+{
+   return token == TBREAK ? "break " : "continue ";
+}
+
+} // namespace liquid
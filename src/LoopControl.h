@@ -0,0 +1,26 @@
+#pragma once
+#include "AstNode.h"
+
+namespace liquid
+{
+
+/*! Represents a break or continue statement of a while loop. */
+class LoopControl : public Statement
+{
+public:
+   LoopControl(int token, YYLTYPE loc) : token(token), location(loc) {}
+   virtual ~LoopControl() = default;
+
+   llvm::Value* codeGen(CodeGenContext& context) override;
+   NodeType     getType() override { return NodeType::expression; }
+   std::string  toString() override;
+   void         Accept(Visitor& v) override { v.VisitStatement(this); }
+
+   YYLTYPE& getLocation() { return location; }
+
+private:
+   int     token{0};
+   YYLTYPE location;
+};
+
+} // namespace liquid
@@ -0,0 +1,225 @@
+#include "Match.h"
+#include "CodeGenContext.h"
+#include "parser.hpp"
+
+#include <map>
+#include <set>
+#include <unordered_set>
+
+using namespace llvm;
+
+namespace liquid
+{
+
+namespace
+{
+/*! The hash of a string, the same as liq_str_hash computes at run time (FNV-1a). */
+uint64_t stringHash(const std::string& str)
+{
+   uint64_t hash = 14695981039346656037ull;
+   for (unsigned char c : str) {
+      hash ^= c;
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
+/*! Selects a slot of a table with 2^bits slots by the bits of the hash starting at shift. */
+struct SlotFunction
+{
+   unsigned shift{0};
+   unsigned bits{0};
+
+   uint64_t slot(uint64_t hash) const { return (hash >> shift) & ((uint64_t(1) << bits) - 1); }
+};
+
+/*! Searches the bits of the hashes, which are different for all of them, in a table of up to 4 times the
+ * count of hashes. If there are none, some slots are shared by several hashes of the largest table.
+ */
+SlotFunction findSlotFunction(const std::vector<uint64_t>& hashes)
+{
+   unsigned minBits = 0;
+   while ((size_t(1) << minBits) < hashes.size()) {
+      ++minBits;
+   }
+   for (unsigned bits = minBits; bits <= minBits + 2; ++bits) {
+      for (unsigned shift = 0; shift + bits <= 64; ++shift) {
+         SlotFunction                 function{shift, bits};
+         std::unordered_set<uint64_t> slots;
+         bool                         perfect = true;
+         for (auto hash : hashes) {
+            if (!slots.insert(function.slot(hash)).second) {
+               perfect = false;
+               break;
+            }
+         }
+         if (perfect) {
+            return function;
+         }
+      }
+   }
+   return {0, minBits + 2};
+}
+} // namespace
+
+MatchCase::~MatchCase()
+{
+   if (values != nullptr) {
+      for (auto value : *values) {
+         delete value;
+      }
+      delete values;
+   }
+   delete block;
+}
+
+Match::~Match()
+{
+   delete expr;
+   if (cases != nullptr) {
+      for (auto matchCase : *cases) {
+         delete matchCase;
+      }
+      delete cases;
+   }
+   delete elseBlock;
+}
+
+Value* Match::codeGen(CodeGenContext& context)
+{
+   Value* value = expr->codeGen(context);
+   if (value == nullptr) {
+      return nullptr;
+   }
+   bool isString = context.isString(value);
+   if (!isString && !value->getType()->isIntegerTy(64)) {
+      Node::printError(location, "The value of a match must be an int or a string, but it is a " + context.typeNameOf(value->getType()) + ".");
+      context.addError();
+      return nullptr;
+   }
+
+   Function*                function     = context.currentBlock()->getParent();
+   BasicBlock*              mergeBlock   = BasicBlock::Create(context.getGlobalContext(), "match_end");
+   BasicBlock*              defaultBlock = elseBlock != nullptr ? BasicBlock::Create(context.getGlobalContext(), "match_else") : mergeBlock;
+   std::vector<BasicBlock*> caseBlocks;
+   for (size_t i = 0; i < cases->size(); ++i) {
+      caseBlocks.push_back(BasicBlock::Create(context.getGlobalContext(), "case"));
+   }
+   bool dispatched = isString ? codeGenStringDispatch(value, defaultBlock, caseBlocks, context) : codeGenIntDispatch(value, defaultBlock, caseBlocks, context);
+   if (!dispatched) {
+      return nullptr;
+   }
+
+   // A case doesn't fall through into the next one, each one continues after the match.
+   bool needMergeBlock = elseBlock == nullptr;
+   for (size_t i = 0; i < cases->size(); ++i) {
+      function->insert(function->end(), caseBlocks[i]);
+      context.newScope(caseBlocks[i]);
+      (*cases)[i]->getBlock()->codeGen(context);
+      if (context.currentBlock()->getTerminator() == nullptr) {
+         BranchInst::Create(mergeBlock, context.currentBlock());
+         needMergeBlock = true;
+      }
+      context.endScope();
+   }
+   if (elseBlock != nullptr) {
+      function->insert(function->end(), defaultBlock);
+      context.newScope(defaultBlock);
+      elseBlock->codeGen(context);
+      if (context.currentBlock()->getTerminator() == nullptr) {
+         BranchInst::Create(mergeBlock, context.currentBlock());
+         needMergeBlock = true;
+      }
+      context.endScope();
+   }
+   if (needMergeBlock) {
+      function->insert(function->end(), mergeBlock);
+      context.setInsertPoint(mergeBlock);
+   }
+   return mergeBlock;
+}
+
+bool Match::codeGenIntDispatch(llvm::Value* value, llvm::BasicBlock* defaultBlock, const std::vector<llvm::BasicBlock*>& caseBlocks, CodeGenContext& context)
+{
+   std::vector<std::pair<long long, BasicBlock*>> entries;
+   std::set<long long>                            seen;
+   for (size_t i = 0; i < cases->size(); ++i) {
+      for (auto caseValue : *(*cases)[i]->getValues()) {
+         if (caseValue->getType() != NodeType::integer) {
+            Node::printError((*cases)[i]->getLocation(), "The case values of a match over an int must be integer literals.");
+            context.addError();
+            return false;
+         }
+         auto number = static_cast<Integer*>(caseValue)->getValue();
+         if (!seen.insert(number).second) {
+            Node::printError((*cases)[i]->getLocation(), "Duplicate case value " + std::to_string(number) + ".");
+            context.addError();
+            return false;
+         }
+         entries.emplace_back(number, caseBlocks[i]);
+      }
+   }
+   auto dispatch = SwitchInst::Create(value, defaultBlock, static_cast<unsigned>(entries.size()), context.currentBlock());
+   for (auto& entry : entries) {
+      dispatch->addCase(cast<ConstantInt>(ConstantInt::get(value->getType(), entry.first, true)), entry.second);
+   }
+   return true;
+}
+
+bool Match::codeGenStringDispatch(llvm::Value* value, llvm::BasicBlock* defaultBlock, const std::vector<llvm::BasicBlock*>& caseBlocks, CodeGenContext& context)
+{
+   std::vector<std::pair<String*, BasicBlock*>> entries;
+   std::vector<uint64_t>                        hashes;
+   std::set<std::string>                        seen;
+   for (size_t i = 0; i < cases->size(); ++i) {
+      for (auto caseValue : *(*cases)[i]->getValues()) {
+         if (caseValue->getType() != NodeType::string) {
+            Node::printError((*cases)[i]->getLocation(), "The case values of a match over a string must be string literals.");
+            context.addError();
+            return false;
+         }
+         auto literal = static_cast<String*>(caseValue);
+         if (!seen.insert(literal->getValue()).second) {
+            Node::printError((*cases)[i]->getLocation(), "Duplicate case value '" + literal->getValue() + "'.");
+            context.addError();
+            return false;
+         }
+         entries.emplace_back(literal, caseBlocks[i]);
+         hashes.push_back(stringHash(literal->getValue()));
+      }
+   }
+
+   // The slot of the hash selects the case value to compare with, a string which isn't a case value goes to the default.
+   auto   slotFunction = findSlotFunction(hashes);
+   auto   intType      = Type::getInt64Ty(context.getGlobalContext());
+   Value* slot         = context.callBuiltin("liq_str_hash", {value});
+   if (slotFunction.shift != 0) {
+      slot = BinaryOperator::Create(Instruction::LShr, slot, ConstantInt::get(intType, slotFunction.shift), "slot", context.currentBlock());
+   }
+   slot = BinaryOperator::Create(Instruction::And, slot, ConstantInt::get(intType, (uint64_t(1) << slotFunction.bits) - 1), "slot", context.currentBlock());
+
+   std::map<uint64_t, std::vector<size_t>> slots;
+   for (size_t i = 0; i < entries.size(); ++i) {
+      slots[slotFunction.slot(hashes[i])].push_back(i);
+   }
+   Function* function = context.currentBlock()->getParent();
+   auto      dispatch = SwitchInst::Create(slot, defaultBlock, static_cast<unsigned>(slots.size()), context.currentBlock());
+   for (auto& [slotIndex, indices] : slots) {
+      BasicBlock* compareBlock = BasicBlock::Create(context.getGlobalContext(), "match_compare", function);
+      dispatch->addCase(cast<ConstantInt>(ConstantInt::get(intType, slotIndex)), compareBlock);
+      // Usually there is one case value per slot, otherwise they are compared one after the other.
+      for (size_t k = 0; k < indices.size(); ++k) {
+         auto& entry = entries[indices[k]];
+         context.setInsertPoint(compareBlock);
+         Value*      literal   = entry.first->codeGen(context);
+         Value*      equal     = context.callBuiltin("liq_str_equal", {value, literal});
+         Value*      isEqual   = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_NE, equal, ConstantInt::get(intType, 0), "is_equal", compareBlock);
+         BasicBlock* nextBlock = k + 1 < indices.size() ? BasicBlock::Create(context.getGlobalContext(), "match_compare", function) : defaultBlock;
+         BranchInst::Create(entry.second, nextBlock, isEqual, compareBlock);
+         compareBlock = nextBlock;
+      }
+   }
+   return true;
+}
+
+} // namespace liquid
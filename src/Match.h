@@ -0,0 +1,57 @@
+#pragma once
+#include "AstNode.h"
+
+namespace liquid
+{
+
+/*! Represents a case of a match statement, the block is run if the value is one of the case values. */
+class MatchCase
+{
+public:
+   MatchCase(ExpressionList* values, Block* block, YYLTYPE loc) : values(values), block(block), location(loc) {}
+   ~MatchCase();
+
+   ExpressionList* getValues() { return values; }
+   Block*          getBlock() { return block; }
+   YYLTYPE&        getLocation() { return location; }
+
+private:
+   ExpressionList* values{nullptr};
+   Block*          block{nullptr};
+   YYLTYPE         location;
+};
+
+/*! Represents a match statement over an int or a string value.
+ * The case values are integer or string literals.
+ */
+class Match : public Statement
+{
+public:
+   Match(Expression* expr, MatchCaseList* cases, Block* elseBlock, YYLTYPE loc) : expr(expr), cases(cases), elseBlock(elseBlock), location(loc) {}
+   virtual ~Match();
+
+   llvm::Value* codeGen(CodeGenContext& context) override;
+   NodeType     getType() override { return NodeType::expression; }
+   std::string  toString() override { return "match "; }
+   void         Accept(Visitor& v) override { v.VisitMatch(this); }
+
+   Expression*    getExpression() { return expr; }
+   MatchCaseList* getCases() { return cases; }
+   Block*         getElseBlock() { return elseBlock; }
+
+private:
+   /*! Dispatches an int by a switch instruction, which LLVM lowers to a jump table or a binary search. */
+   bool codeGenIntDispatch(llvm::Value* value, llvm::BasicBlock* defaultBlock, const std::vector<llvm::BasicBlock*>& caseBlocks, CodeGenContext& context);
+
+   /*! Dispatches a string by a perfect hash of the case values: the hash selects the only case value, which can match,
+    * so one string compare follows.
+    */
+   bool codeGenStringDispatch(llvm::Value* value, llvm::BasicBlock* defaultBlock, const std::vector<llvm::BasicBlock*>& caseBlocks, CodeGenContext& context);
+
+   Expression*    expr{nullptr};
+   MatchCaseList* cases{nullptr};
+   Block*         elseBlock{nullptr};
+   YYLTYPE        location;
+};
+
+} // namespace liquid
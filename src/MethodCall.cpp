@@ -4,6 +4,10 @@
 #include "FunctionDeclaration.h"
 #include "Declaration.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
 using namespace std;
 using namespace llvm;
 
@@ -13,58 +17,50 @@ namespace liquid
 Value* MethodCall::codeGen(CodeGenContext& context)
 {
    std::string functionName = id->getName();
-   if (!id->getStructName().empty()) {
-      std::string className = context.getType(id->getStructName());
-      functionName += "%" + className;
-   }
-
-   Function* function = context.getModule()->getFunction(functionName);
-   if (function == nullptr) {
-      // see if it is a added function to the class like function(classname param,...)
-      functionName = id->getName();
-      function     = context.getModule()->getFunction(functionName);
-      if (function == nullptr) {
-         // May be it is a class function, but called like a function w/o class prefix
-         // like: class.function() -> function(class parameter)
-         functionName = id->getName() + "%" + getTypeNameOfFirstArg(context);
-         function     = context.getModule()->getFunction(functionName);
-
-         if (function == nullptr) {
-            // Or it is a function w/ template parameter which will be generated when the parameter types are known.
-            auto funcdecl = context.getTemplateFunction(id->getName());
-            if( funcdecl == nullptr ) {
-               Node::printError(location, " no such function '" + id->getName() + "'");
-               context.addError();
-               return nullptr;
-            }
-         }
+   if( id->getStructName().empty() && (functionName == "display" || functionName == "displayln") && !arguments->empty()
+       && arguments->front()->getType() == NodeType::string ) {
+      return codeGenDisplay(context);
+   }
+   // The receiver is either given as object.method(arguments) or as first argument like method(object, arguments).
+   // A function with a class object as first parameter is registered as method of that class, too.
+   std::string receiverName = id->getStructName();
+   if( receiverName.empty() ) {
+      receiverName = getReceiverOfFirstArg(context);
+   }
+   std::string receiverClass = receiverName.empty() ? "" : context.getType(receiverName);
+   size_t      arity         = arguments->size() - (id->getStructName().empty() && !receiverName.empty() ? 1 : 0);
+   Function*   function      = context.findCallTarget(id->getName(), receiverClass, arity);
+   if( function == nullptr ) {
+      // Or it is a function w/ template parameter which will be generated when the parameter types are known.
+      auto funcdecl = context.getTemplateFunction(id->getName());
+      if( funcdecl == nullptr && isMathBuiltin(id->getName(), arguments->size()) ) {
+         return codeGenMathBuiltin(context);
+      }
+      if( funcdecl == nullptr && isArrayBuiltin(id->getName()) ) {
+         return codeGenArrayBuiltin(context);
+      }
+      if( funcdecl == nullptr && isStringBuiltin(id->getName()) ) {
+         return codeGenStringBuiltin(context);
+      }
+      if( funcdecl == nullptr && isMapBuiltin(id->getName()) ) {
+         return codeGenMapBuiltin(context);
+      }
+      if( funcdecl == nullptr ) {
+         Node::printError(location, " no such function '" + id->getName() + "'");
+         context.addError();
+         return nullptr;
       }
    }
 
    std::vector<Value*> args;
-   if (!id->getStructName().empty()) {
-      // This a class method call, so put the class object onto the stack in order the function has
-      // access via a local alloca
-      Value* val = context.findVariable(id->getStructName());
-      assert(val != nullptr);
-      args.push_back(val);
-   } else {
-      // Check if first parameter is a class object, means variable of a class and a method of this class
-      // exists. Then call this method.
-      // Since it is possible to call a class.method(arguments)
-      // like method(class, arguments).
-      if (arguments->size() && arguments->front()->getType() == NodeType::identifier) {
-         Identifier* ident = (Identifier*)*(arguments->begin());
-         // Check if it is a var of class type...
-         std::string typeName = context.getType(ident->getName());
-         AllocaInst* allocInst   = context.findVariable(ident->getName());
-         if( allocInst != nullptr ) {
-            if( allocInst->getAllocatedType()->isStructTy() ) {
-               args.push_back(allocInst);
-               delete ident;
-               arguments->erase(begin(*arguments));
-            }
-         }
+   if( !receiverName.empty() ) {
+      // This a class method call, so pass the pointer to the class object as first argument.
+      AllocaInst* alloc = context.findVariable(receiverName);
+      assert(alloc != nullptr);
+      args.push_back(new LoadInst(alloc->getAllocatedType(), alloc, "this", context.currentBlock()));
+      if( id->getStructName().empty() ) {
+         delete arguments->front();
+         arguments->erase(begin(*arguments));
       }
    }
 
@@ -87,9 +83,14 @@ Value* MethodCall::codeGen(CodeGenContext& context)
          auto fparam = funcparams->at(i);
          // Exchange the var parameter with the type of the real used type by the call.
          if( fparam->getIdentifierOfVariablenType().getName() == "var" ) {
-            auto actualType = new Identifier(context.typeNameOf(args[i]->getType()), fparam->getLocation());
+            // A string and an object are both pointers, the recorded type tells them apart.
+            auto typeName   = args[i]->getType()->isPointerTy() ? context.getLiquidType(args[i]) : "";
+            auto actualType = new Identifier(typeName.empty() ? context.typeNameOf(args[i]->getType()) : typeName, fparam->getLocation());
             auto identifier = new Identifier(fparam->getIdentifierOfVariable());
             auto substitudeParam = new VariableDeclaration(actualType, identifier, fparam->getLocation());
+            if( fparam->isAssigned() ) {
+               substitudeParam->setAssigned();
+            }
             funcparams->at(i) = substitudeParam;
             delete fparam;
          }
@@ -100,15 +101,481 @@ Value* MethodCall::codeGen(CodeGenContext& context)
       delete funcdecl;
    }
 
-   return CallInst::Create(function, args, "", context.currentBlock());
+   // A list passed to a typed array parameter is converted.
+   auto ftype = function->getFunctionType();
+   if( ftype->isVarArg() ) {
+      // Default argument promotion like in C, a boolean is passed as int.
+      for( auto i = ftype->getNumParams(); i < args.size(); ++i ) {
+         if( args[i]->getType()->isIntegerTy(1) ) {
+            args[i] = CastInst::Create(Instruction::ZExt, args[i], Type::getInt32Ty(context.getGlobalContext()), "promote", context.currentBlock());
+         }
+      }
+   }
+   for( auto i = 0u; i < args.size() && i < ftype->getNumParams(); ++i ) {
+      auto paramTy = ftype->getParamType(i);
+      if( context.isArrayType(paramTy) && args[i]->getType() != paramTy ) {
+         // A list of the same element type is passed as view, otherwise it is copied.
+         auto array = context.arrayViewOf(args[i], paramTy);
+         if( array == nullptr ) {
+            array = context.convertToArray(args[i], paramTy);
+         }
+         if( array == nullptr ) {
+            Node::printError(location, "Argument " + std::to_string(i + 1) + " of '" + id->getName() + "' must be a " + context.typeNameOf(paramTy) + ".");
+            context.addError();
+            return nullptr;
+         }
+         args[i] = array;
+      }
+   }
+
+   auto call = CallInst::Create(function, args, "", context.currentBlock());
+   call->setCallingConv(function->getCallingConv());
+   return call;
+}
+
+/*! A math built in function. */
+struct MathBuiltin
+{
+   size_t        count;     ///< Count of arguments.
+   Intrinsic::ID intrinsic; ///< The intrinsic of the function, of min/max the one of the doubles.
+   bool          isInteger; ///< True if the function takes integers.
+};
+
+///< The math built in functions, they are intrinsics, so the optimizer can fold, hoist and vectorize them.
+static const std::map<std::string, MathBuiltin> mathBuiltins{
+   {"sqrt", {1, Intrinsic::sqrt, false}},     {"sin", {1, Intrinsic::sin, false}},
+   {"cos", {1, Intrinsic::cos, false}},       {"exp", {1, Intrinsic::exp, false}},
+   {"log", {1, Intrinsic::log, false}},       {"pow", {2, Intrinsic::pow, false}},
+   {"fabs", {1, Intrinsic::fabs, false}},     {"floor", {1, Intrinsic::floor, false}},
+   {"ceil", {1, Intrinsic::ceil, false}},     {"fma", {3, Intrinsic::fma, false}},
+   {"min", {2, Intrinsic::minnum, false}},    {"max", {2, Intrinsic::maxnum, false}},
+   {"popcount", {1, Intrinsic::ctpop, true}}, {"ctz", {1, Intrinsic::cttz, true}}};
+
+bool MethodCall::isMathBuiltin(const std::string& name, size_t count)
+{
+   auto found = mathBuiltins.find(name);
+   // min/max of one argument are the ones of the typed arrays.
+   return found != mathBuiltins.end() && (found->second.count == count || (name != "min" && name != "max"));
+}
+
+Value* MethodCall::codeGenMathBuiltin(CodeGenContext& context)
+{
+   std::string name    = id->getName();
+   auto&       builtin = mathBuiltins.at(name);
+   if( arguments->size() != builtin.count ) {
+      Node::printError(location, "'" + name + "' expects " + std::to_string(builtin.count) + " argument(s).");
+      context.addError();
+      return nullptr;
+   }
+
+   auto                intType    = context.getGenericIntegerType();
+   auto                doubleType = Type::getDoubleTy(context.getGlobalContext());
+   std::vector<Value*> args;
+   bool                allIntegers = true;
+   for( auto expr : *arguments ) {
+      auto arg = expr->codeGen(context);
+      if( arg == nullptr ) {
+         return nullptr;
+      }
+      if( arg->getType() != intType && (builtin.isInteger || arg->getType() != doubleType) ) {
+         Node::printError(location, "Argument " + std::to_string(args.size() + 1) + " of '" + name + "' must be " + (builtin.isInteger ? "an integer." : "a number."));
+         context.addError();
+         return nullptr;
+      }
+      allIntegers &= arg->getType() == intType;
+      args.push_back(arg);
+   }
+
+   IRBuilder<> builder(context.currentBlock());
+   if( builtin.isInteger ) {
+      if( builtin.intrinsic == Intrinsic::cttz ) {
+         // ctz(0) is 64
+         args.push_back(builder.getFalse());
+      }
+      return builder.CreateIntrinsic(builtin.intrinsic, {intType}, args);
+   }
+   if( allIntegers && (name == "min" || name == "max") ) {
+      return builder.CreateIntrinsic(name == "min" ? Intrinsic::smin : Intrinsic::smax, {intType}, args);
+   }
+   for( auto& arg : args ) {
+      if( arg->getType() == intType ) {
+         arg = builder.CreateSIToFP(arg, doubleType, "castdb");
+      }
+   }
+   return context.applyFastMath(builder.CreateIntrinsic(builtin.intrinsic, {doubleType}, args));
+}
+
+///< The built in functions of the typed arrays and their count of arguments.
+static const std::map<std::string, size_t> arrayBuiltins{
+   {"len", 1}, {"sum", 1}, {"min", 1}, {"max", 1}, {"dot", 2}, {"axpy", 3}, {"scale", 2}, {"fill", 2}};
+
+bool MethodCall::isArrayBuiltin(const std::string& name) { return arrayBuiltins.count(name) != 0; }
+
+Value* MethodCall::codeGenArrayBuiltin(CodeGenContext& context)
+{
+   std::string name = id->getName();
+   if( arguments->size() != arrayBuiltins.at(name) ) {
+      Node::printError(location, "'" + name + "' expects " + std::to_string(arrayBuiltins.at(name)) + " argument(s).");
+      context.addError();
+      return nullptr;
+   }
+
+   std::vector<Value*> args;
+   for( auto expr : *arguments ) {
+      auto arg = expr->codeGen(context);
+      if( arg == nullptr ) {
+         return nullptr;
+      }
+      args.push_back(arg);
+   }
+
+   auto block      = context.currentBlock();
+   auto intType    = context.getGenericIntegerType();
+   auto doubleType = Type::getDoubleTy(context.getGlobalContext());
+
+   // Converts a list into a typed array, int[] if all elements are integers otherwise double[].
+   auto toArray = [&](size_t i) -> Value* {
+      auto value = args[i];
+      auto array = context.arrayViewOf(value);
+      if( array != nullptr ) {
+         return array;
+      }
+      array = context.convertToArray(value, context.getArrayType(intType));
+      if( array == nullptr ) {
+         array = context.convertToArray(value, context.getArrayType(doubleType));
+      }
+      if( array == nullptr ) {
+         Node::printError(location, "Argument " + std::to_string(i + 1) + " of '" + name + "' must be an array of numbers.");
+         context.addError();
+      }
+      return array;
+   };
+   auto toDouble = [&](Value* value) -> Value* {
+      if( value->getType() == intType ) {
+         return CastInst::Create(Instruction::SIToFP, value, doubleType, "castdb", block);
+      }
+      return value;
+   };
+   auto data   = [&](Value* array) { return ExtractValueInst::Create(array, {0}, "data", block); };
+   auto length = [&](Value* array) { return ExtractValueInst::Create(array, {1}, "len", block); };
+   auto minLength = [&](Value* a, Value* b) -> Value* {
+      auto lenA = length(a);
+      auto lenB = length(b);
+      auto less = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_SLT, lenA, lenB, "cmp_len", block);
+      return SelectInst::Create(less, lenA, lenB, "len", block);
+   };
+   auto suffix = [&](Value* array) { return context.getArrayElementType(array->getType()) == intType ? std::string("_i64") : std::string("_f64"); };
+
+   if( name == "fill" ) {
+      auto count = args[0];
+      auto value = args[1];
+      if( count->getType() != intType || (value->getType() != intType && value->getType() != doubleType) ) {
+         Node::printError(location, "'fill' expects an integer count and a number.");
+         context.addError();
+         return nullptr;
+      }
+      auto array = context.createArray(context.getArrayType(value->getType()), count);
+      context.callBuiltin("liq_fill" + suffix(array), {data(array), value, count});
+      return array;
+   }
+
+   if( name == "len" && context.isString(args[0]) ) {
+      return context.stringLength(args[0]);
+   }
+   if( name == "len" && context.isMapType(args[0]->getType()) ) {
+      return context.callMapBuiltin("len", args[0], nullptr);
+   }
+   if( name == "len" && context.isSoaType(args[0]->getType()) ) {
+      return context.soaLength(args[0]);
+   }
+   if( name == "len" || name == "sum" || name == "min" || name == "max" ) {
+      auto array = toArray(0);
+      if( array == nullptr ) {
+         return nullptr;
+      }
+      if( name == "len" ) {
+         return length(array);
+      }
+      return context.callBuiltin("liq_" + name + suffix(array), {data(array), length(array)});
+   }
+
+   // The remaining ones take two arrays, mixed element types are calculated as double.
+   size_t first = (name == "dot") ? 0 : 1;
+   auto x = toArray(first);
+   auto y = (name == "scale") ? x : toArray(first + 1);
+   if( x == nullptr || y == nullptr ) {
+      return nullptr;
+   }
+   Value* alpha = (name == "dot") ? nullptr : args[0];
+   if( alpha != nullptr && alpha->getType() != intType && alpha->getType() != doubleType ) {
+      Node::printError(location, "The factor of '" + name + "' must be a number.");
+      context.addError();
+      return nullptr;
+   }
+   bool isDouble = x->getType() != y->getType() || context.getArrayElementType(x->getType()) == doubleType || (alpha != nullptr && alpha->getType() == doubleType);
+   if( isDouble ) {
+      auto doubleArrayType = context.getArrayType(doubleType);
+      x = context.convertToArray(x, doubleArrayType);
+      y = (name == "scale") ? x : context.convertToArray(y, doubleArrayType);
+      if( alpha != nullptr ) {
+         alpha = toDouble(alpha);
+      }
+   }
+
+   auto count = minLength(x, y);
+   if( name == "dot" ) {
+      return context.callBuiltin("liq_dot" + suffix(x), {data(x), data(y), count});
+   }
+   auto result = context.createArray(x->getType(), count);
+   if( name == "scale" ) {
+      context.callBuiltin("liq_scale" + suffix(x), {data(result), alpha, data(x), count});
+   } else {
+      context.callBuiltin("liq_axpy" + suffix(x), {data(result), alpha, data(x), data(y), count});
+   }
+   return result;
+}
+
+/*! A part of a display format, either literal text or one conversion specification. */
+struct FormatPart
+{
+   std::string text;           ///< The literal text or the conversion specification w/o the length modifier.
+   char        conversion{0};  ///< The conversion character, 0 for literal text.
+   bool        plain{false};   ///< True if the conversion has no flags, width or precision.
+};
+
+/*! Splits a printf like format into literal text and conversions.
+ * \param[out] error The reason if the format is invalid.
+ */
+static std::vector<FormatPart> splitFormat(const std::string& format, std::string& error)
+{
+   std::vector<FormatPart> parts;
+   std::string             text;
+   for( size_t i = 0; i < format.size(); ++i ) {
+      if( format[i] != '%' ) {
+         text += format[i];
+         continue;
+      }
+      if( i + 1 < format.size() && format[i + 1] == '%' ) {
+         text += '%';
+         ++i;
+         continue;
+      }
+      if( !text.empty() ) {
+         parts.push_back({text});
+         text.clear();
+      }
+      size_t begin = i++;
+      while( i < format.size() && std::strchr("-+ #0", format[i]) != nullptr ) ++i;
+      while( i < format.size() && (std::isdigit(static_cast<unsigned char>(format[i])) || format[i] == '.' || format[i] == '*') ) ++i;
+      std::string spec = format.substr(begin, i - begin);
+      if( spec.find('*') != std::string::npos ) {
+         error = "A '*' width or precision is not supported.";
+         return {};
+      }
+      // All integers are 64 bit and all floating point numbers are double, so the length is implied.
+      while( i < format.size() && std::strchr("hlLqjzt", format[i]) != nullptr ) ++i;
+      if( i >= format.size() || std::strchr("diuoxXcfFeEgGaAs", format[i]) == nullptr ) {
+         error = "Invalid conversion '" + format.substr(begin, i + 1 - begin) + "' in the format.";
+         return {};
+      }
+      parts.push_back({spec, format[i], spec == "%"});
+   }
+   if( !text.empty() || parts.empty() ) {
+      parts.push_back({text});
+   }
+   return parts;
+}
+
+Value* MethodCall::codeGenDisplay(CodeGenContext& context)
+{
+   std::string format = static_cast<String*>(arguments->front())->getValue();
+   if( id->getName() == "displayln" ) {
+      format += '\n';
+   }
+   std::string error;
+   auto        parts = splitFormat(format, error);
+   if( !error.empty() ) {
+      Node::printError(location, error);
+      context.addError();
+      return nullptr;
+   }
+   auto conversions = std::count_if(parts.begin(), parts.end(), [](const FormatPart& part) { return part.conversion != 0; });
+   if( static_cast<size_t>(conversions) != arguments->size() - 1 ) {
+      Node::printError(location, "The format expects " + std::to_string(conversions) + " argument(s), but " + std::to_string(arguments->size() - 1) + " are given.");
+      context.addError();
+      return nullptr;
+   }
+
+   // All arguments are evaluated before anything is written, a function called by an argument may write too.
+   auto                intType    = context.getGenericIntegerType();
+   auto                doubleType = Type::getDoubleTy(context.getGlobalContext());
+   auto                argument   = std::next(arguments->begin());
+   size_t              argNo      = 2;
+   std::vector<Value*> values;
+   for( auto& part : parts ) {
+      if( part.conversion == 0 ) {
+         continue;
+      }
+      auto value = (*argument++)->codeGen(context);
+      if( value == nullptr ) {
+         return nullptr;
+      }
+      if( value->getType()->isIntegerTy(1) ) {
+         value = CastInst::Create(Instruction::ZExt, value, intType, "promote", context.currentBlock());
+      }
+      std::string expected;
+      switch( part.conversion ) {
+         case 's':
+            expected = context.isString(value) ? "" : "a string";
+            break;
+         case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            expected = value->getType() == doubleType ? "" : "a double";
+            break;
+         default:
+            expected = value->getType() == intType ? "" : "an integer";
+            break;
+      }
+      if( !expected.empty() ) {
+         Node::printError(location, "'%" + std::string(1, part.conversion) + "' expects " + expected + " as argument " + std::to_string(argNo) + ".");
+         context.addError();
+         return nullptr;
+      }
+      values.push_back(value);
+      ++argNo;
+   }
+
+   auto   value = values.begin();
+   Value* last  = nullptr;
+   for( auto& part : parts ) {
+      if( part.conversion == 0 ) {
+         auto literal = context.getStringLiteral(part.text);
+         last = context.callBuiltin("liq_write_lit", {literal, ConstantInt::get(intType, part.text.size())});
+         continue;
+      }
+      std::string writer;
+      std::string spec = part.text;
+      switch( part.conversion ) {
+         case 's':
+            writer = "str";
+            break;
+         case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            writer = "f64";
+            part.plain &= part.conversion == 'f' || part.conversion == 'F';
+            break;
+         default:
+            writer = "i64";
+            part.plain &= part.conversion == 'd' || part.conversion == 'i';
+            if( part.conversion != 'c' ) {
+               spec += "ll";
+            }
+            break;
+      }
+      if( part.plain ) {
+         last = context.callBuiltin("liq_write_" + writer, {*value});
+      } else {
+         last = context.callBuiltin("liq_write_fmt_" + writer, {context.getStringLiteral(spec + part.conversion), *value});
+      }
+      ++value;
+   }
+   return last;
+}
+
+///< The built in functions of the strings and their count of arguments.
+static const std::map<std::string, size_t> stringBuiltins{{"hash", 1}, {"substr", 3}};
+
+bool MethodCall::isStringBuiltin(const std::string& name) { return stringBuiltins.count(name) != 0; }
+
+Value* MethodCall::codeGenStringBuiltin(CodeGenContext& context)
+{
+   std::string name = id->getName();
+   if( arguments->size() != stringBuiltins.at(name) ) {
+      Node::printError(location, "'" + name + "' expects " + std::to_string(stringBuiltins.at(name)) + " argument(s).");
+      context.addError();
+      return nullptr;
+   }
+
+   std::vector<Value*> args;
+   for( auto expr : *arguments ) {
+      auto arg = expr->codeGen(context);
+      if( arg == nullptr ) {
+         return nullptr;
+      }
+      args.push_back(arg);
+   }
+   if( !context.isString(args[0]) ) {
+      Node::printError(location, "Argument 1 of '" + name + "' must be a string.");
+      context.addError();
+      return nullptr;
+   }
+   if( name == "hash" ) {
+      return context.callBuiltin("liq_str_hash", {args[0]});
+   }
+   auto intType = context.getGenericIntegerType();
+   if( args[1]->getType() != intType || args[2]->getType() != intType ) {
+      Node::printError(location, "'substr' expects an integer begin and count.");
+      context.addError();
+      return nullptr;
+   }
+   return context.callBuiltin("liq_str_substr", args);
 }
 
-std::string MethodCall::getTypeNameOfFirstArg(CodeGenContext& context)
+///< The built in functions of the maps and their minimal and maximal count of arguments.
+static const std::map<std::string, std::pair<size_t, size_t>> mapBuiltins{
+   {"put", {3, 3}}, {"get", {2, 3}}, {"contains", {2, 2}}, {"remove", {2, 2}}};
+
+bool MethodCall::isMapBuiltin(const std::string& name) { return mapBuiltins.count(name) != 0; }
+
+Value* MethodCall::codeGenMapBuiltin(CodeGenContext& context)
+{
+   std::string name  = id->getName();
+   auto        count = mapBuiltins.at(name);
+   if( arguments->size() < count.first || arguments->size() > count.second ) {
+      auto expected = std::to_string(count.first) + (count.first != count.second ? " or " + std::to_string(count.second) : "");
+      Node::printError(location, "'" + name + "' expects " + expected + " argument(s).");
+      context.addError();
+      return nullptr;
+   }
+
+   std::vector<Value*> args;
+   for( auto expr : *arguments ) {
+      auto arg = expr->codeGen(context);
+      if( arg == nullptr ) {
+         return nullptr;
+      }
+      args.push_back(arg);
+   }
+   auto mapType = args[0]->getType();
+   if( !context.isMapType(mapType) ) {
+      Node::printError(location, "Argument 1 of '" + name + "' must be a map.");
+      context.addError();
+      return nullptr;
+   }
+   auto key = context.convertMapItem(args[1], context.getMapKeyType(mapType));
+   if( key == nullptr ) {
+      Node::printError(location, "The key of '" + name + "' doesn't match the key type of " + context.typeNameOf(mapType) + ".");
+      context.addError();
+      return nullptr;
+   }
+   Value* value = nullptr;
+   if( args.size() > 2 ) {
+      value = context.convertMapItem(args[2], context.getMapValueType(mapType));
+      if( value == nullptr ) {
+         Node::printError(location, "The value of '" + name + "' doesn't match the value type of " + context.typeNameOf(mapType) + ".");
+         context.addError();
+         return nullptr;
+      }
+   }
+   return context.callMapBuiltin(name, args[0], key, value);
+}
+
+std::string MethodCall::getReceiverOfFirstArg(CodeGenContext& context)
 {
    if (arguments->size() && arguments->front()->getType() == NodeType::identifier) {
       Identifier* ident = static_cast<Identifier*>(*(arguments->begin()));
       // Check if it is a var of class type...
-      return context.getType(ident->getName());
+      if (ident->getStructName().empty() && context.findVariable(ident->getName()) != nullptr && context.isClass(context.getType(ident->getName()))) {
+         return ident->getName();
+      }
    }
    return "";
 }
@@ -32,7 +32,51 @@ public:
    ExpressionList* getArguments() { return arguments; }
 
 private:
-   std::string getTypeNameOfFirstArg(CodeGenContext& context);
+   /*! Returns the name of the first argument, if it is a variable of a class type, otherwise an empty string. */
+   std::string getReceiverOfFirstArg(CodeGenContext& context);
+
+   /*! Returns true if name is one of the math built in functions taking count arguments.
+    * - sqrt, sin, cos, exp, log, pow, fabs, floor, ceil, fma of doubles
+    * - min(a, b), max(a, b) of integers or doubles
+    * - popcount, ctz of integers
+    */
+   static bool isMathBuiltin(const std::string& name, size_t count);
+
+   /*! Generates a math built in function as LLVM intrinsic. */
+   llvm::Value* codeGenMathBuiltin(CodeGenContext& context);
+
+   /*! Returns true if name is one of the built in functions of the typed arrays.
+    * - len(a), sum(a), min(a), max(a), dot(a, b)
+    * - axpy(alpha, x, y) -> alpha * x + y, scale(alpha, x) -> alpha * x
+    * - fill(n, value) -> array of n times value
+    */
+   static bool isArrayBuiltin(const std::string& name);
+
+   /*! Generates the call of a array built in function. A list argument is converted to a typed array. */
+   llvm::Value* codeGenArrayBuiltin(CodeGenContext& context);
+
+   /*! Generates display/displayln with a literal format as a sequence of typed writes.
+    * The format is split at compile time and the argument types are checked against the conversions.
+    */
+   llvm::Value* codeGenDisplay(CodeGenContext& context);
+
+   /*! Returns true if name is one of the built in functions of the strings.
+    * - len(s) (see the array built in functions)
+    * - hash(s), substr(s, begin, count)
+    */
+   static bool isStringBuiltin(const std::string& name);
+
+   /*! Generates the call of a string built in function. */
+   llvm::Value* codeGenStringBuiltin(CodeGenContext& context);
+
+   /*! Returns true if name is one of the built in functions of the maps.
+    * - len(m) (see the array built in functions)
+    * - put(m, key, value), get(m, key), get(m, key, default), contains(m, key), remove(m, key)
+    */
+   static bool isMapBuiltin(const std::string& name);
+
+   /*! Generates the call of a map built in function, specialized for the key and value type of the map. */
+   llvm::Value* codeGenMapBuiltin(CodeGenContext& context);
 
    Identifier*     id{nullptr};
    ExpressionList* arguments{nullptr};
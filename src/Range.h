@@ -23,6 +23,7 @@ private:
    YYLTYPE     location;
    friend class VisitorSyntaxCheck;
    friend class VisitorPrettyPrint;
+   friend class VisitorAssignedVariables;
 };
 
 } // namespace liquid
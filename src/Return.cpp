@@ -14,6 +14,38 @@ Value* Return::codeGen(CodeGenContext& context)
       Value* ret = retExpr->codeGen(context);
       if (ret == nullptr)
          return nullptr;
+      auto list = dyn_cast<AllocaInst>(ret);
+      if (list != nullptr && list->getAllocatedType()->isStructTy()) {
+         // A new list lives on the stack of this function, return it by value.
+         ret = new LoadInst(list->getAllocatedType(), list, "ret_list", context.currentBlock());
+         // A typed array in the list may view a list on the stack of this function.
+         ret = context.escapingList(ret);
+      }
+      auto retTy = context.currentBlock()->getParent()->getReturnType();
+      if (context.isArrayType(retTy) && ret->getType() != retTy) {
+         // e.g. a list literal returned by a function of type int[]
+         auto array = context.convertToArray(ret, retTy);
+         if (array == nullptr) {
+            Node::printError(location, "Return value can't be converted to " + context.typeNameOf(retTy) + ".");
+            context.addError();
+            return nullptr;
+         }
+         ret = array;
+      }
+      if (context.isArrayType(retTy)) {
+         // A view of a list on the stack of this function would be invalid in the caller.
+         ret = context.escapingArray(ret);
+      }
+      auto intTy = context.getGenericIntegerType();
+      if (ret->getType() == intTy && retTy->isDoubleTy()) {
+         ret = CastInst::Create(Instruction::SIToFP, ret, retTy, "castdb", context.currentBlock());
+      } else if (ret->getType()->isDoubleTy() && retTy == intTy) {
+         ret = CastInst::Create(Instruction::FPToSI, ret, retTy, "castint", context.currentBlock());
+      } else if (ret->getType()->isIntegerTy(1) && retTy == intTy) {
+         ret = CastInst::Create(Instruction::ZExt, ret, retTy, "promote", context.currentBlock());
+      } else if (ret->getType() == intTy && retTy->isIntegerTy(1)) {
+         ret = new ICmpInst(*context.currentBlock(), ICmpInst::ICMP_NE, ret, ConstantInt::get(intTy, 0), "tobool");
+      }
       return ReturnInst::Create(context.getGlobalContext(), ret, context.currentBlock());
    } else {
       return ReturnInst::Create(context.getGlobalContext(), 0, context.currentBlock());
@@ -0,0 +1,232 @@
+#include "TieredCompiler.h"
+#include "CodeGenContext.h"
+#include "buildins.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace llvm;
+
+namespace liquid {
+
+TieredCompiler* TieredCompiler::active = nullptr;
+
+TieredCompiler::~TieredCompiler() { stop(); }
+
+void TieredCompiler::prepare(Module& module)
+{
+   auto& llvmContext = module.getContext();
+   auto  ptrType     = PointerType::getUnqual(llvmContext);
+   auto  intType     = Type::getInt64Ty(llvmContext);
+
+   std::vector<Function*> tiered;
+   for( auto& function : module ) {
+      if( !function.isDeclaration() && &function != module.getFunction("main") ) {
+         tiered.push_back(&function);
+      }
+   }
+   for( auto function : tiered ) {
+      // The slot starts with the unoptimized code, the optimized one replaces it.
+      auto slot = new GlobalVariable(module, ptrType, false, GlobalValue::ExternalLinkage, function, function->getName() + ".slot");
+      slot->setAlignment(Align(8));
+      for( auto user : make_early_inc_range(function->users()) ) {
+         auto call = dyn_cast<CallInst>(user);
+         if( call == nullptr || call->getCalledOperand() != function ) {
+            continue;
+         }
+         IRBuilder<> builder(call);
+         auto        code = builder.CreateAlignedLoad(ptrType, slot, Align(8), function->getName() + ".code");
+         code->setAtomic(AtomicOrdering::Monotonic);
+         call->setCalledOperand(code);
+      }
+      functions.push_back(function->getName().str());
+   }
+   // The optimized code is compiled in a module of its own, it refers to the functions and the variables
+   // of the unoptimized code by name. Constants are copied.
+   for( auto& function : module ) {
+      if( !function.isDeclaration() && function.hasName() ) {
+         function.setLinkage(GlobalValue::ExternalLinkage);
+         shared.push_back(function.getName().str());
+      }
+   }
+   for( auto& global : module.globals() ) {
+      if( !global.isConstant() && global.hasName() ) {
+         global.setLinkage(GlobalValue::ExternalLinkage);
+         shared.push_back(global.getName().str());
+      }
+   }
+   raw_svector_ostream stream(bitcode);
+   WriteBitcodeToFile(module, stream);
+
+   auto tierUp = module.getFunction("liq_tier_up");
+   if( tierUp == nullptr ) {
+      return;
+   }
+   for( size_t id = 0; id < tiered.size(); ++id ) {
+      auto function = tiered[id];
+      auto counter  = new GlobalVariable(module, intType, false, GlobalValue::InternalLinkage, ConstantInt::get(intType, 0),
+                                         function->getName() + ".count");
+      // Counted are the calls at the end of the entry block and the iterations at the loop headers.
+      DominatorTree             dominators(*function);
+      LoopInfo                  loops(dominators);
+      std::vector<Instruction*> points;
+      auto&                     entry    = function->getEntryBlock();
+      auto                      mustTail = entry.getTerminatingMustTailCall();
+      points.push_back(mustTail != nullptr ? mustTail : entry.getTerminator());
+      for( auto loop : loops.getLoopsInPreorder() ) {
+         points.push_back(&*loop->getHeader()->getFirstInsertionPt());
+      }
+      for( auto point : points ) {
+         IRBuilder<> builder(point);
+         auto        count = builder.CreateAdd(builder.CreateLoad(intType, counter), ConstantInt::get(intType, 1));
+         builder.CreateStore(count, counter);
+         auto hot = builder.CreateICmpEQ(count, ConstantInt::get(intType, threshold));
+         builder.SetInsertPoint(SplitBlockAndInsertIfThen(hot, point, false));
+         builder.CreateCall(tierUp, {ConstantInt::get(intType, id)});
+      }
+   }
+}
+
+void TieredCompiler::start(ExecutionEngine& engine)
+{
+   for( auto& name : functions ) {
+      slots.push_back(reinterpret_cast<std::atomic<uint64_t>*>(engine.getGlobalValueAddress(name + ".slot")));
+   }
+   for( auto& name : shared ) {
+      sharedAddresses.push_back(engine.getGlobalValueAddress(name));
+   }
+   active = this;
+   worker = std::thread(&TieredCompiler::run, this);
+}
+
+int TieredCompiler::stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      queue.clear();
+   }
+   wakeUp.notify_one();
+   if( worker.joinable() ) {
+      worker.join();
+   }
+   if( active == this ) {
+      active = nullptr;
+   }
+   return optimized;
+}
+
+void TieredCompiler::request(int64_t id)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      if( stopping ) {
+         return;
+      }
+      queue.push_back(id);
+   }
+   wakeUp.notify_one();
+}
+
+void TieredCompiler::run()
+{
+   for( ;; ) {
+      int64_t id;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         wakeUp.wait(lock, [this] { return stopping || !queue.empty(); });
+         if( stopping ) {
+            return;
+         }
+         id = queue.front();
+         queue.pop_front();
+      }
+      optimize(id);
+   }
+}
+
+void TieredCompiler::optimize(int64_t id)
+{
+   Tier tier;
+   tier.llvmContext = std::make_unique<LLVMContext>();
+   StringRef buffer(bitcode.data(), bitcode.size());
+   auto      parsed = parseBitcodeFile(MemoryBufferRef(buffer, "tiered"), *tier.llvmContext);
+   if( !parsed ) {
+      consumeError(parsed.takeError());
+      return;
+   }
+   auto&  name   = functions[id];
+   Module* module = parsed->get();
+   // Only the hot function is compiled, the other functions and the variables are the ones of the running code.
+   for( auto& function : *module ) {
+      if( !function.isDeclaration() && function.getName() != name ) {
+         function.deleteBody();
+      }
+   }
+   for( auto& global : module->globals() ) {
+      if( !global.isConstant() ) {
+         global.setInitializer(nullptr);
+         global.setLinkage(GlobalValue::ExternalLinkage);
+      }
+   }
+
+   std::string   err;
+   EngineBuilder builder{std::move(*parsed)};
+   builder.setErrorStr(&err).setEngineKind(EngineKind::JIT).setMCPU(sys::getHostCPUName());
+   std::unique_ptr<TargetMachine> targetMachine(builder.selectTarget());
+   if( targetMachine == nullptr ) {
+      return;
+   }
+   // The messages are reported by the main thread after the script, each one once.
+   std::ostringstream log;
+   context.linkRuntime(*module, log);
+   context.optimize(*module, *targetMachine, log);
+   auto message = log.str();
+   if( !message.empty() && std::find(diagnostics.begin(), diagnostics.end(), message) == diagnostics.end() ) {
+      diagnostics.push_back(message);
+   }
+   tier.engine.reset(builder.create(targetMachine.release()));
+   if( tier.engine == nullptr ) {
+      return;
+   }
+   context.mapBuiltins(*tier.engine);
+   for( size_t i = 0; i < shared.size(); ++i ) {
+      if( shared[i] == name ) {
+         continue;
+      }
+      if( sharedAddresses[i] == 0 ) {
+         return;
+      }
+      tier.engine->addGlobalMapping(shared[i], sharedAddresses[i]);
+   }
+   tier.engine->finalizeObject();
+   auto code = tier.engine->getFunctionAddress(name);
+   if( code == 0 ) {
+      return;
+   }
+   slots[id]->store(code, std::memory_order_release);
+   tiers.push_back(std::move(tier));
+   ++optimized;
+}
+
+} // namespace liquid
+
+extern "C" DECLSPEC void liq_tier_up(int64_t function)
+{
+   if( liquid::TieredCompiler::active == nullptr ) {
+      return;
+   }
+   try {
+      liquid::TieredCompiler::active->request(function);
+   } catch( const std::exception& ) {
+      // Called as nounwind, without the request the function stays at the first tier.
+   }
+}
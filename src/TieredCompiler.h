@@ -0,0 +1,90 @@
+#ifndef TieredCompiler_h__
+#define TieredCompiler_h__
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+namespace liquid {
+
+class CodeGenContext;
+
+/*! Runs the script unoptimized first and optimizes the hot functions in the background (-m tiered).
+ *  Each function is called through a slot, which holds the address of its current code.
+ *  The unoptimized code counts the calls and the loop iterations of a function. When the count
+ *  reaches the threshold, a worker thread compiles the function with O2 in a module of its own
+ *  and stores the address of the optimized code into the slot, so the next call runs it.
+ */
+class TieredCompiler
+{
+public:
+   /*! Calls and loop iterations of a function until it is optimized. */
+   static constexpr int64_t threshold = 10000;
+
+   explicit TieredCompiler(CodeGenContext& context) : context(context) {}
+   ~TieredCompiler();
+   TieredCompiler(const TieredCompiler&) = delete;
+   TieredCompiler& operator=(const TieredCompiler&) = delete;
+
+   /*! Redirects the calls of the functions of module through their slots and adds the counters.
+    *  The module without the counters is kept as bitcode, the optimized functions are compiled from it.
+    */
+   void prepare(llvm::Module& module);
+
+   /*! Looks up the slots and the shared globals in the compiled module and starts the worker. */
+   void start(llvm::ExecutionEngine& engine);
+
+   /*! Stops the worker, functions not yet optimized stay unoptimized.
+    * \return The count of the optimized functions.
+    */
+   int stop();
+
+   /*! Returns the problems the worker had, e.g. the runtime not linked. Valid after stop(). */
+   const std::vector<std::string>& getDiagnostics() const { return diagnostics; }
+
+   /*! Queues the function with the index id to be optimized, called by liq_tier_up. */
+   void request(int64_t id);
+
+   /*! The compiler of the running script, liq_tier_up reports to it. */
+   static TieredCompiler* active;
+
+private:
+   struct Tier
+   {
+      std::unique_ptr<llvm::LLVMContext>     llvmContext;
+      std::unique_ptr<llvm::ExecutionEngine> engine;
+   };
+
+   void run();
+
+   /*! Compiles the function with O2 and stores the address of its code into its slot. */
+   void optimize(int64_t id);
+
+   CodeGenContext&             context;
+   llvm::SmallVector<char, 0>  bitcode;  ///< The module with slots but without counters.
+   std::vector<std::string>    functions; ///< The functions by their index.
+   std::vector<std::string>    shared;    ///< The globals the optimized code uses from the unoptimized module.
+   std::vector<uint64_t>       sharedAddresses;
+   std::vector<std::atomic<uint64_t>*> slots;
+   std::vector<Tier>           tiers;     ///< The optimized code, kept until the script is done.
+   std::vector<std::string>    diagnostics; ///< Written by the worker only.
+   std::thread                 worker;
+   std::mutex                  mutex;
+   std::condition_variable     wakeUp;
+   std::deque<int64_t>         queue;
+   bool                        stopping{false};
+   int                         optimized{0};
+};
+
+}
+#endif // TieredCompiler_h__
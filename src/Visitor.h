@@ -26,7 +26,10 @@ namespace liquid {
    class Array;
    class ArrayAccess;
    class ArrayAddElement;
+   class ArrayElementAssignment;
+   class ArraySlice;
    class Range;
+   class Match;
 
 class Visitor
 {
@@ -54,7 +57,10 @@ public:
    virtual void VisitArray(Array* expr) = 0;
    virtual void VisitArrayAccess(ArrayAccess* expr) = 0;
    virtual void VisitArrayAddElement(ArrayAddElement* expr) = 0;
+   virtual void VisitArrayElementAssignment(ArrayElementAssignment* expr) = 0;
+   virtual void VisitArraySlice(ArraySlice* expr) = 0;
    virtual void VisitRange(Range* expr) = 0;
+   virtual void VisitMatch(Match* expr) = 0;
 };
 
 }
@@ -0,0 +1,215 @@
+#include "VisitorAssignedVariables.h"
+#include "AstNode.h"
+#include "Return.h"
+#include "FunctionDeclaration.h"
+#include "ClassDeclaration.h"
+#include "Conditional.h"
+#include "UnaryOperator.h"
+#include "BinaryOperator.h"
+#include "CompareOperator.h"
+#include "Assignment.h"
+#include "MethodCall.h"
+#include "Declaration.h"
+#include "WhileLoop.h"
+#include "Array.h"
+#include "Range.h"
+#include "Match.h"
+
+namespace liquid {
+
+void VisitorAssignedVariables::visitScope( Expression* block )
+{
+   scopes.emplace_back();
+   block->Accept( *this );
+   scopes.pop_back();
+}
+
+void VisitorAssignedVariables::VisitExpression( Expression* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitInteger( Integer* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitDouble( Double* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitString( String* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitBoolean( Boolean* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitIdentifier( Identifier* expr ) { (void)expr; }
+
+void VisitorAssignedVariables::VisitUnaryOperator( UnaryOperator* expr )
+{
+   expr->getRHS()->Accept( *this );
+}
+
+void VisitorAssignedVariables::VisitBinaryOp( BinaryOp* expr )
+{
+   expr->getLHS()->Accept( *this );
+   expr->getRHS()->Accept( *this );
+}
+
+void VisitorAssignedVariables::VisitCompOperator( CompOperator* expr )
+{
+   expr->getLHS()->Accept( *this );
+   expr->getRHS()->Accept( *this );
+}
+
+void VisitorAssignedVariables::VisitBlock( Block* expr )
+{
+   for( auto stmt : expr->statements ) {
+      stmt->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitStatement( Statement* stmt ) { (void)stmt; }
+
+void VisitorAssignedVariables::VisitReturnStatement( Return* retstmt )
+{
+   if( retstmt->getRetExpression() ) {
+      retstmt->getRetExpression()->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitFunctionDeclaration( FunctionDeclaration* fndecl )
+{
+   scopes.emplace_back();
+   for( auto parameter : *fndecl->getParameter() ) {
+      scopes.back()[parameter->getVariablenName()] = parameter;
+   }
+   fndecl->getBody()->Accept( *this );
+   scopes.pop_back();
+}
+
+void VisitorAssignedVariables::VisitExpressionStatement( ExpressionStatement* expr )
+{
+   expr->getExpression()->Accept( *this );
+}
+
+void VisitorAssignedVariables::VisitAssigment( Assignment* expr )
+{
+   expr->getExpression()->Accept( *this );
+   // The instance variable of an object isn't a local variable.
+   if( !expr->getIdentifier()->getStructName().empty() ) {
+      return;
+   }
+   // Searched from the inner to the outer scope. A block of a function also reaches the variables of the
+   // code around the function, like the code generator does.
+   auto name = expr->getIdentifier()->getName();
+   for( auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope ) {
+      auto found = scope->find( name );
+      if( found != scope->end() ) {
+         found->second->setAssigned();
+         return;
+      }
+   }
+}
+
+void VisitorAssignedVariables::VisitMethodCall( MethodCall* expr )
+{
+   for( auto arg : *expr->getArguments() ) {
+      arg->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitVariablenDeclaration( VariableDeclaration* expr )
+{
+   // The initializer is no assignment after the declaration, and it doesn't see the variable yet.
+   if( expr->hasAssignmentExpr() ) {
+      expr->getAssignment()->Accept( *this );
+   }
+   scopes.back()[expr->getVariablenName()] = expr;
+}
+
+void VisitorAssignedVariables::VisitConditional( Conditional* expr )
+{
+   expr->getCompOperator()->Accept( *this );
+   if( expr->getThen() ) {
+      visitScope( expr->getThen() );
+   }
+   if( expr->getElse() ) {
+      visitScope( expr->getElse() );
+   }
+}
+
+void VisitorAssignedVariables::VisitWhileLoop( WhileLoop* expr )
+{
+   expr->getCondition()->Accept( *this );
+   visitScope( expr->getLoopBlock() );
+   if( expr->getElseBlock() ) {
+      visitScope( expr->getElseBlock() );
+   }
+}
+
+void VisitorAssignedVariables::VisitClassDeclaration( ClassDeclaration* expr )
+{
+   if( expr->getBlock() ) {
+      visitScope( expr->getBlock() );
+   }
+}
+
+void VisitorAssignedVariables::VisitArray( Array* expr )
+{
+   for( auto element : *expr->getExpressions() ) {
+      element->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitArrayAccess( ArrayAccess* expr )
+{
+   if( expr->other != nullptr ) {
+      expr->other->Accept( *this );
+   }
+   if( expr->indexExpr != nullptr ) {
+      expr->indexExpr->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitArrayAddElement( ArrayAddElement* expr )
+{
+   if( expr->getExpression() ) {
+      expr->getExpression()->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitArrayElementAssignment( ArrayElementAssignment* expr )
+{
+   expr->getElement()->Accept( *this );
+   expr->getExpression()->Accept( *this );
+}
+
+void VisitorAssignedVariables::VisitArraySlice( ArraySlice* expr )
+{
+   if( expr->begin != nullptr ) {
+      expr->begin->Accept( *this );
+   }
+   if( expr->end != nullptr ) {
+      expr->end->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitRange( Range* expr )
+{
+   if( expr->begin != nullptr ) {
+      expr->begin->Accept( *this );
+   }
+   if( expr->end != nullptr ) {
+      expr->end->Accept( *this );
+   }
+}
+
+void VisitorAssignedVariables::VisitMatch( Match* expr )
+{
+   expr->getExpression()->Accept( *this );
+   for( auto matchCase : *expr->getCases() ) {
+      if( matchCase->getValues() ) {
+         for( auto value : *matchCase->getValues() ) {
+            value->Accept( *this );
+         }
+      }
+      visitScope( matchCase->getBlock() );
+   }
+   if( expr->getElseBlock() ) {
+      visitScope( expr->getElseBlock() );
+   }
+}
+
+}
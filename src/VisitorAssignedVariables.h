@@ -0,0 +1,57 @@
+#ifndef VisitorAssignedVariables_h__
+#define VisitorAssignedVariables_h__
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Visitor.h"
+
+namespace liquid {
+
+/*! Marks the variable declarations, whose variable is assigned after the declaration.
+ *  A scalar variable, which is never assigned, keeps its value, so the code generator
+ *  uses the value itself instead of a stack slot. An assignment is resolved to the declaration
+ *  visible in its scope, so a variable of the same name in another function or block isn't affected.
+ */
+class VisitorAssignedVariables : public Visitor
+{
+   /*! The declared variables of a scope by name. */
+   using Scope = std::map<std::string, VariableDeclaration*>;
+   std::vector<Scope> scopes{Scope()}; ///< The innermost scope is the last.
+
+   /*! Visits a block in a scope of its own, like the code generator does for the blocks of if, while and match. */
+   void visitScope( Expression* block );
+public:
+   VisitorAssignedVariables() = default;
+   virtual ~VisitorAssignedVariables() = default;
+   void VisitExpression(Expression* expr);
+   void VisitInteger( Integer* expr );
+   void VisitDouble( Double* expr );
+   void VisitString( String* expr );
+   void VisitBoolean( Boolean* expr );
+   void VisitIdentifier( Identifier* expr );
+   void VisitUnaryOperator( UnaryOperator* expr );
+   void VisitBinaryOp( BinaryOp* expr );
+   void VisitCompOperator( CompOperator* expr );
+   void VisitBlock( Block* expr );
+   void VisitStatement( Statement* stmt );
+   void VisitReturnStatement( Return* retstmt );
+   void VisitFunctionDeclaration( FunctionDeclaration* fndecl );
+   void VisitExpressionStatement(ExpressionStatement* expr);
+   void VisitAssigment(Assignment* expr);
+   void VisitMethodCall(MethodCall* expr);
+   void VisitVariablenDeclaration(VariableDeclaration* expr);
+   void VisitConditional(Conditional* expr);
+   void VisitWhileLoop(WhileLoop* expr);
+   void VisitClassDeclaration(ClassDeclaration* expr);
+   void VisitArray(Array* expr);
+   void VisitArrayAccess(ArrayAccess* expr);
+   void VisitArrayAddElement(ArrayAddElement* expr);
+   void VisitArrayElementAssignment(ArrayElementAssignment* expr);
+   void VisitArraySlice(ArraySlice* expr);
+   void VisitRange(Range* expr);
+   void VisitMatch(Match* expr);
+};
+
+}
+#endif // VisitorAssignedVariables_h__
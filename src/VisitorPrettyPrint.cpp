@@ -13,6 +13,7 @@
 #include "Array.h"
 #include "CompareOperator.h"
 #include "Range.h"
+#include "Match.h"
 
 namespace liquid {
 
@@ -215,11 +216,18 @@ void VisitorPrettyPrint::VisitArray(Array* expr)
 
 void VisitorPrettyPrint::VisitArrayAccess(ArrayAccess* expr)
 {
-   out << indent_spaces(indent) << "Create " << expr->toString() << " to element " << expr->index << std::endl;
+   if( expr->indexExpr != nullptr ) {
+      out << indent_spaces(indent) << "Create " << expr->toString() << " to element " << expr->indexExpr->toString() << std::endl;
+   } else {
+      out << indent_spaces(indent) << "Create " << expr->toString() << " to element " << expr->index << std::endl;
+   }
    ++indent;
    if( expr->other != nullptr ) {
       expr->other->Accept(*this);
    }
+   if( expr->indexExpr != nullptr ) {
+      expr->indexExpr->Accept(*this);
+   }
    --indent;
 }
 
@@ -233,6 +241,28 @@ void VisitorPrettyPrint::VisitArrayAddElement(ArrayAddElement* expr)
    --indent;
 }
 
+void VisitorPrettyPrint::VisitArrayElementAssignment(ArrayElementAssignment* expr)
+{
+   out << indent_spaces(indent) << "Create " << expr->toString() << " of " << expr->getExpression()->toString() << std::endl;
+   ++indent;
+   expr->getElement()->Accept(*this);
+   expr->getExpression()->Accept(*this);
+   --indent;
+}
+
+void VisitorPrettyPrint::VisitArraySlice(ArraySlice* expr)
+{
+   out << indent_spaces(indent) << "Create " << expr->toString() << " of " << expr->ident->getName() << std::endl;
+   ++indent;
+   if( expr->begin != nullptr ) {
+      expr->begin->Accept(*this);
+   }
+   if( expr->end != nullptr ) {
+      expr->end->Accept(*this);
+   }
+   --indent;
+}
+
 void VisitorPrettyPrint::VisitRange(Range* expr)
 {
    out << indent_spaces(indent) << "Create " << expr->toString() << std::endl;
@@ -246,4 +276,20 @@ void VisitorPrettyPrint::VisitRange(Range* expr)
    --indent;
 }
 
+void VisitorPrettyPrint::VisitMatch(Match* expr)
+{
+   out << indent_spaces(indent) << "Create " << expr->toString() << std::endl;
+   ++indent;
+   expr->getExpression()->Accept(*this);
+   for( auto matchCase : *expr->getCases() ) {
+      out << indent_spaces(indent) << "Create Case" << std::endl;
+      matchCase->getBlock()->Accept(*this);
+   }
+   if( expr->getElseBlock() ) {
+      out << indent_spaces(indent) << "Create Else Body" << std::endl;
+      expr->getElseBlock()->Accept(*this);
+   }
+   --indent;
+}
+
 }
@@ -37,7 +37,10 @@ public:
    void VisitArray(Array* expr);
    void VisitArrayAccess(ArrayAccess* expr);
    void VisitArrayAddElement(ArrayAddElement* expr);
+   void VisitArrayElementAssignment(ArrayElementAssignment* expr);
+   void VisitArraySlice(ArraySlice* expr);
    void VisitRange(Range* expr);
+   void VisitMatch(Match* expr);
 };
 
 }
@@ -13,10 +13,22 @@
 #include "Declaration.h"
 #include "WhileLoop.h"
 #include "Array.h"
+#include "CodeGenContext.h"
 #include "Range.h"
+#include "Match.h"
 
 namespace liquid {
 
+VisitorSyntaxCheck::VisitorSyntaxCheck()
+{
+   // Each combination of a key and a value type is a map type.
+   for( auto& key : mapKeyTypes ) {
+      for( auto value : mapValueTypes ) {
+         TypeNames.emplace( std::string( "map<" ) + key.name + "," + value + ">" );
+      }
+   }
+}
+
 void VisitorSyntaxCheck::VisitExpression( Expression* expr ) { (void)expr; }
 
 void VisitorSyntaxCheck::VisitStatement(Statement* stmt) { (void)stmt; }
@@ -98,6 +110,7 @@ void VisitorSyntaxCheck::VisitWhileLoop( WhileLoop* expr ) { (void)expr; }
 void VisitorSyntaxCheck::VisitClassDeclaration( ClassDeclaration* expr )
 {
    TypeNames.emplace(expr->getIdentifier()->getName());
+   TypeNames.emplace("soa<" + expr->getIdentifier()->getName() + ">");
 }
 void VisitorSyntaxCheck::VisitArray(Array* expr)
 {
@@ -113,10 +126,29 @@ void VisitorSyntaxCheck::VisitArrayAccess(ArrayAccess* expr)
    if( expr->other != nullptr ) {
       expr->other->Accept(*this);
    }
+   if( expr->indexExpr != nullptr ) {
+      expr->indexExpr->Accept(*this);
+   }
 }
 
 void VisitorSyntaxCheck::VisitArrayAddElement(ArrayAddElement* expr) { (void)expr; }
 
+void VisitorSyntaxCheck::VisitArrayElementAssignment(ArrayElementAssignment* expr)
+{
+   expr->getElement()->Accept(*this);
+   expr->getExpression()->Accept(*this);
+}
+
+void VisitorSyntaxCheck::VisitArraySlice(ArraySlice* expr)
+{
+   if( expr->begin != nullptr ) {
+      expr->begin->Accept(*this);
+   }
+   if( expr->end != nullptr ) {
+      expr->end->Accept(*this);
+   }
+}
+
 void VisitorSyntaxCheck::VisitRange(Range* expr)
 {
    switch( expr->begin->getType() ) {
@@ -126,6 +158,8 @@ void VisitorSyntaxCheck::VisitRange(Range* expr)
          break;
       case NodeType::expression:
          break;
+      case NodeType::binaryop:
+         break;
       case NodeType::list:
          break;
       case NodeType::variable:
@@ -141,6 +175,8 @@ void VisitorSyntaxCheck::VisitRange(Range* expr)
          break;
       case NodeType::expression:
          break;
+      case NodeType::binaryop:
+         break;
       case NodeType::list:
          break;
       case NodeType::variable:
@@ -158,4 +194,14 @@ void VisitorSyntaxCheck::VisitRange(Range* expr)
    }
 }
 
+void VisitorSyntaxCheck::VisitMatch(Match* expr)
+{
+   for( auto matchCase : *expr->getCases() ) {
+      matchCase->getBlock()->Accept(*this);
+   }
+   if( expr->getElseBlock() ) {
+      expr->getElseBlock()->Accept(*this);
+   }
+}
+
 }
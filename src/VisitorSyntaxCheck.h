@@ -13,9 +13,9 @@ class VisitorSyntaxCheck : public Visitor
 {
    int syntaxErrors{0};
    std::vector<YYLTYPE> ReturnStatementLocations;
-   std::unordered_set<std::string> TypeNames{ "int","double","string","boolean","var" };
+   std::unordered_set<std::string> TypeNames{ "int","double","string","boolean","var","int[]","double[]" };
 public:
-   VisitorSyntaxCheck() = default;
+   VisitorSyntaxCheck();
    virtual ~VisitorSyntaxCheck() = default;
    void VisitExpression(Expression* expr);
    void VisitInteger( Integer* expr );
@@ -40,7 +40,10 @@ public:
    void VisitArray(Array* expr);
    void VisitArrayAccess(ArrayAccess* expr);
    void VisitArrayAddElement(ArrayAddElement* expr);
+   void VisitArrayElementAssignment(ArrayElementAssignment* expr);
+   void VisitArraySlice(ArraySlice* expr);
    void VisitRange(Range* expr);
+   void VisitMatch(Match* expr);
 
    bool hasErrors() { return syntaxErrors != 0 ; }
 };
@@ -10,63 +10,77 @@ namespace liquid
 
 Value* WhileLoop::codeGen(CodeGenContext& context)
 {
-   Function*   function       = context.currentBlock()->getParent();
-   BasicBlock* firstCondBlock = BasicBlock::Create(context.getGlobalContext(), "firstcond", function);
-   BasicBlock* condBB         = BasicBlock::Create(context.getGlobalContext(), "cond");
-   BasicBlock* loopBB         = BasicBlock::Create(context.getGlobalContext(), "loop");
-   BasicBlock* elseBB         = BasicBlock::Create(context.getGlobalContext(), "else");
-   BasicBlock* mergeBB        = BasicBlock::Create(context.getGlobalContext(), "merge");
-   BranchInst::Create(firstCondBlock, context.currentBlock());
-   context.newScope(firstCondBlock);
-   Value* firstCondValue = this->condition->codeGen(context);
-   if (firstCondValue == nullptr) {
+   Function*   function   = context.currentBlock()->getParent();
+   BasicBlock* entryBlock = context.currentBlock();
+   BasicBlock* condBB     = BasicBlock::Create(context.getGlobalContext(), "cond", function);
+   BasicBlock* loopBB     = BasicBlock::Create(context.getGlobalContext(), "loop");
+   BasicBlock* latchBB    = BasicBlock::Create(context.getGlobalContext(), "latch");
+   BasicBlock* mergeBB    = BasicBlock::Create(context.getGlobalContext(), "merge");
+   BranchInst::Create(condBB, entryBlock);
+
+   // The condition is generated only once. The else block needs to know whether the condition is checked the
+   // first time, which is a phi in front of it.
+   PHINode*    firstPass = nullptr;
+   BasicBlock* exitBB    = mergeBB;
+   if (this->elseBlock != nullptr) {
+      firstPass = PHINode::Create(Type::getInt1Ty(context.getGlobalContext()), 2, "first", condBB);
+      firstPass->addIncoming(ConstantInt::getTrue(context.getGlobalContext()), entryBlock);
+      exitBB = BasicBlock::Create(context.getGlobalContext(), "exit");
+   }
+   context.newScope(condBB);
+   Value* condValue = this->condition->codeGen(context);
+   if (condValue == nullptr) {
       Node::printError("Missing condition in while loop.");
       context.addError();
       return nullptr;
    }
-   if (!firstCondValue->getType()->isIntegerTy(1)) {
+   if (!condValue->getType()->isIntegerTy(1)) {
       Node::printError( "While condition doesn't result in a boolean expression.");
       context.addError();
       return nullptr;
    }
-   BranchInst::Create(loopBB, elseBB, firstCondValue, context.currentBlock());
-
-   function->insert(function->end(), condBB);
-   context.endScope();
-   context.newScope(condBB);
-   Value* condValue = this->condition->codeGen(context);
-   if (condValue == nullptr) {
-      Node::printError("Code gen for condition expression in while loop failed.");
-      context.addError();
-      return nullptr;
-   }
-   BranchInst::Create(loopBB, mergeBB, condValue, context.currentBlock());
+   BranchInst::Create(loopBB, exitBB, condValue, context.currentBlock());
 
    function->insert(function->end(), loopBB);
    context.endScope();
    context.newScope(loopBB);
+   context.pushLoop({function, mergeBB, latchBB});
    Value* loopValue = this->loopBlock->codeGen(context);
+   context.popLoop();
    if (loopValue == nullptr) {
       Node::printError("Code gen for loop value in while loop failed.");
       context.addError();
       return nullptr;
    }
-   BranchInst::Create(condBB, context.currentBlock());
-
-   function->insert(function->end(), elseBB);
+   if (context.currentBlock()->getTerminator() == nullptr) {
+      BranchInst::Create(latchBB, context.currentBlock());
+   }
    context.endScope();
-   context.newScope(elseBB);
+
+   // The body and continue go back to the condition via the latch.
+   function->insert(function->end(), latchBB);
+   BranchInst::Create(condBB, latchBB);
+
    if (this->elseBlock != nullptr) {
+      // The else block is run, if the condition fails the first time.
+      firstPass->addIncoming(ConstantInt::getFalse(context.getGlobalContext()), latchBB);
+      BasicBlock* elseBB = BasicBlock::Create(context.getGlobalContext(), "else");
+      function->insert(function->end(), exitBB);
+      BranchInst::Create(elseBB, mergeBB, firstPass, exitBB);
+      function->insert(function->end(), elseBB);
+      context.newScope(elseBB);
       Value* elseValue = this->elseBlock->codeGen(context);
       if (elseValue == nullptr) {
          Node::printError("Code gen for else block in while loop failed.");
          context.addError();
          return nullptr;
       }
+      if (context.currentBlock()->getTerminator() == nullptr) {
+         BranchInst::Create(mergeBB, context.currentBlock());
+      }
+      context.endScope();
    }
-   BranchInst::Create(mergeBB, context.currentBlock());
    function->insert(function->end(), mergeBB);
-   context.endScope();
    context.setInsertPoint(mergeBB);
    return mergeBB;
 }
@@ -1,20 +1,123 @@
 #include <stdarg.h>
 #include <stdio.h>
-#include <iostream>
+#include <cerrno>
 #include <cstring>
 #include <cmath>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <io.h>
+#define LIQ_WRITE(fd, data, size) _write(fd, data, static_cast<unsigned int>(size))
+#define LIQ_ISATTY(fd) _isatty(fd)
+#else
+#include <unistd.h>
+#define LIQ_WRITE(fd, data, size) ::write(fd, data, size)
+#define LIQ_ISATTY(fd) isatty(fd)
+#endif
 
 #include "buildins.h"
 
+namespace
+{
+/*! The output of the built in functions of a thread goes through this buffer.
+ * It is written with one system call when it is full, at flush() and at the end.
+ * If stdout is a terminal, every completed line is written at once.
+ */
+class OutputBuffer
+{
+public:
+   OutputBuffer() : lineBuffered(LIQ_ISATTY(1) != 0) {}
+   ~OutputBuffer() { flush(); }
+
+   void write(const char* data, size_t size)
+   {
+      if (used + size > sizeof(buffer)) {
+         flush();
+         if (size > sizeof(buffer)) {
+            writeOut(data, size);
+            return;
+         }
+      }
+      std::memcpy(buffer + used, data, size);
+      used += size;
+      if (lineBuffered && std::memchr(data, '\n', size) != nullptr) {
+         flush();
+      }
+   }
+
+   void print(const char* format, va_list args)
+   {
+      va_list retry;
+      va_copy(retry, args);
+      int size = vsnprintf(buffer + used, sizeof(buffer) - used, format, args);
+      if (size >= 0 && used + size < sizeof(buffer)) {
+         used += size;
+         if (lineBuffered && std::memchr(buffer + used - size, '\n', size) != nullptr) {
+            flush();
+         }
+      } else if (size >= 0) {
+         // Doesn't fit, format it again into a large enough buffer.
+         std::string text;
+         try {
+            text.resize(size);
+         } catch (const std::bad_alloc&) {
+            liq_runtime_error("out of memory");
+         }
+         vsnprintf(&text[0], size + 1, format, retry);
+         write(text.data(), text.size());
+      }
+      va_end(retry);
+   }
+
+   void flush()
+   {
+      writeOut(buffer, used);
+      used = 0;
+   }
+
+private:
+   static void writeOut(const char* data, size_t size)
+   {
+      while (size > 0) {
+         auto written = LIQ_WRITE(1, data, size);
+         if (written < 0 && errno == EINTR) {
+            continue;
+         }
+         if (written <= 0) {
+            return;
+         }
+         data += written;
+         size -= written;
+      }
+   }
+
+   char   buffer[64 * 1024];
+   size_t used{0};
+   bool   lineBuffered{false};
+};
+
+thread_local OutputBuffer output;
+
+void print(const char* format, ...)
+{
+   va_list argp;
+   va_start(argp, format);
+   output.print(format, argp);
+   va_end(argp);
+}
+} // namespace
+
 extern "C" DECLSPEC int printvalue(int val)
 {
-   std::cout << "IDEBUG: " << val << "\n";
+   print("IDEBUG: %d\n", val);
    return 1;
 }
 
 extern "C" DECLSPEC double printdouble(double val)
 {
-   std::cout << "DDEBUG: " << val << "\n";
+   print("DDEBUG: %g\n", val);
    return 1.;
 }
 
@@ -22,24 +125,78 @@ extern "C" DECLSPEC void display(char* str, ...)
 {
    va_list argp;
    va_start(argp, str);
-   vprintf(str, argp);
+   output.print(str, argp);
    va_end(argp);
 }
 
 extern "C" DECLSPEC void displayln(char* str, ...)
 {
-   char*   outstr;
    va_list argp;
    va_start(argp, str);
-   outstr = (char*)malloc(strlen(str) + 2);
-   strcpy(outstr, str);
-   strcat(outstr, "\n");
-   vprintf(outstr, argp);
+   output.print(str, argp);
    va_end(argp);
-   free(outstr);
+   output.write("\n", 1);
+}
+
+extern "C" DECLSPEC void liq_flush()
+{
+   output.flush();
+}
+
+extern "C" DECLSPEC void liq_runtime_error(const char* message)
+{
+   output.flush();
+   fprintf(stderr, "Runtime error: %s\n", message);
+   std::exit(1);
+}
+
+extern "C" DECLSPEC void liq_write_lit(const char* str, int64_t length)
+{
+   output.write(str, length);
+}
+
+extern "C" DECLSPEC void liq_write_str(const char* str)
+{
+   output.write(str, liq_str_len(str));
+}
+
+extern "C" DECLSPEC void liq_write_i64(int64_t val)
+{
+   char  digits[24];
+   char* end   = digits + sizeof(digits);
+   char* first = end;
+   // Negate as unsigned, -INT64_MIN doesn't fit into int64_t.
+   uint64_t magnitude = val < 0 ? 0 - static_cast<uint64_t>(val) : static_cast<uint64_t>(val);
+   do {
+      *--first = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+   } while (magnitude != 0);
+   if (val < 0) {
+      *--first = '-';
+   }
+   output.write(first, end - first);
+}
+
+extern "C" DECLSPEC void liq_write_f64(double val)
+{
+   print("%f", val);
+}
+
+extern "C" DECLSPEC void liq_write_fmt_i64(const char* spec, int64_t val)
+{
+   if (spec[std::strlen(spec) - 1] == 'c') {
+      print(spec, static_cast<int>(val));
+   } else {
+      print(spec, static_cast<long long>(val));
+   }
+}
+
+extern "C" DECLSPEC void liq_write_fmt_f64(const char* spec, double val)
+{
+   print(spec, val);
 }
 
-extern "C" DECLSPEC double sinus(double val)
+extern "C" DECLSPEC void liq_write_fmt_str(const char* spec, const char* str)
 {
-   return std::sin(val);
+   print(spec, str);
 }
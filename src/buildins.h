@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 #if defined(_MSC_VER)
 #define DECLSPEC __declspec(dllexport) 
@@ -25,6 +27,7 @@ extern "C" DECLSPEC double printdouble(double val);
 
 /*! Built in display function
  * it works like the C printf function and uses the same format string definition.
+ * A string points to its characters, so it is printed with %s.
  * \param[in] str  The format string.
  */
 extern "C" DECLSPEC void display(char* str, ...);
@@ -34,6 +37,176 @@ extern "C" DECLSPEC void display(char* str, ...);
  */
 extern "C" DECLSPEC void displayln(char* str, ...);
 
-/*! Calculates a sinus.
+/*! Writes the buffered output of display, displayln, printvalue and printdouble.
+ * It is the built in function flush() and called after the program has run.
  */
-extern "C" DECLSPEC double sinus(double val);
+extern "C" DECLSPEC void liq_flush();
+
+/*! Stops the script with an error message, e.g. at a division by zero or if the memory is exhausted.
+ * The buffered output is written first, the message goes to stderr.
+ * The built in functions are called as nounwind, so they report their errors this way and never throw.
+ */
+extern "C" [[noreturn]] DECLSPEC void liq_runtime_error(const char* message);
+
+/*! Typed writers, a display call with a literal format is split into calls of them at compile time.
+ * liq_write_lit writes length characters, liq_write_str writes a string and
+ * liq_write_i64/liq_write_f64 write a number like %lld/%f.
+ * The liq_write_fmt_* ones take a printf conversion specification, e.g. "%-8.3lf", for one value.
+ */
+extern "C" DECLSPEC void liq_write_lit(const char* str, int64_t length);
+extern "C" DECLSPEC void liq_write_str(const char* str);
+extern "C" DECLSPEC void liq_write_i64(int64_t val);
+extern "C" DECLSPEC void liq_write_f64(double val);
+extern "C" DECLSPEC void liq_write_fmt_i64(const char* spec, int64_t val);
+extern "C" DECLSPEC void liq_write_fmt_f64(const char* spec, double val);
+extern "C" DECLSPEC void liq_write_fmt_str(const char* spec, const char* str);
+
+/*
+ *! Typed numeric arrays (int[], double[]), see buildins_array.cpp
+ */
+
+/*! Allocates the cache line aligned storage of a typed array.
+ * \param[in] count    Number of elements.
+ * \param[in] elemSize Size of one element in bytes.
+ * \return Pointer to the uninitialized storage.
+ */
+extern "C" DECLSPEC void* liq_array_alloc(int64_t count, int64_t elemSize);
+
+/*! Frees the storage allocated by liq_array_alloc, data may be nullptr. */
+extern "C" DECLSPEC void liq_array_free(void* data);
+
+/*! Reductions over n elements. min/max of an empty array are 0. */
+extern "C" DECLSPEC int64_t liq_sum_i64(const int64_t* a, int64_t n);
+extern "C" DECLSPEC double liq_sum_f64(const double* a, int64_t n);
+extern "C" DECLSPEC int64_t liq_min_i64(const int64_t* a, int64_t n);
+extern "C" DECLSPEC double liq_min_f64(const double* a, int64_t n);
+extern "C" DECLSPEC int64_t liq_max_i64(const int64_t* a, int64_t n);
+extern "C" DECLSPEC double liq_max_f64(const double* a, int64_t n);
+extern "C" DECLSPEC int64_t liq_dot_i64(const int64_t* a, const int64_t* b, int64_t n);
+extern "C" DECLSPEC double liq_dot_f64(const double* a, const double* b, int64_t n);
+
+/*! out[i] = a * x[i] + y[i] */
+extern "C" DECLSPEC void liq_axpy_i64(int64_t* out, int64_t a, const int64_t* x, const int64_t* y, int64_t n);
+extern "C" DECLSPEC void liq_axpy_f64(double* out, double a, const double* x, const double* y, int64_t n);
+
+/*! out[i] = a * x[i] */
+extern "C" DECLSPEC void liq_scale_i64(int64_t* out, int64_t a, const int64_t* x, int64_t n);
+extern "C" DECLSPEC void liq_scale_f64(double* out, double a, const double* x, int64_t n);
+
+/*! Element-wise out[i] = a[i] op b[i]. An integer division by zero yields 0. */
+extern "C" DECLSPEC void liq_add_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n);
+extern "C" DECLSPEC void liq_sub_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n);
+extern "C" DECLSPEC void liq_mul_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n);
+extern "C" DECLSPEC void liq_div_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n);
+extern "C" DECLSPEC void liq_add_f64(double* out, const double* a, const double* b, int64_t n);
+extern "C" DECLSPEC void liq_sub_f64(double* out, const double* a, const double* b, int64_t n);
+extern "C" DECLSPEC void liq_mul_f64(double* out, const double* a, const double* b, int64_t n);
+extern "C" DECLSPEC void liq_div_f64(double* out, const double* a, const double* b, int64_t n);
+
+/*! Sets all n elements to value. */
+extern "C" DECLSPEC void liq_fill_i64(int64_t* out, int64_t value, int64_t n);
+extern "C" DECLSPEC void liq_fill_f64(double* out, double value, int64_t n);
+
+/*! Converts n integers into doubles. */
+extern "C" DECLSPEC void liq_cvt_i64_f64(double* out, const int64_t* in, int64_t n);
+
+/*
+ *! Strings, see buildins_string.cpp
+ *  A string points to NUL terminated characters preceded by the header {capacity, length}.
+ */
+
+/*! The runtime compiled to bitcode, which is linked into the scripts. The size is 0 if it isn't available. */
+extern const unsigned char liqRuntimeBitcode[];
+extern const size_t        liqRuntimeBitcodeSize;
+
+/*! Allocates an uninitialized string of the given length. */
+extern "C" DECLSPEC char* liq_str_alloc(int64_t length);
+
+/*! Releases all strings created at run time at once, called when the script has been run. */
+extern "C" DECLSPEC void liq_str_release();
+
+/*! Returns the length of a string, without scanning it. */
+extern "C" DECLSPEC int64_t liq_str_len(const char* str);
+
+/*! Returns the new string a + b. */
+extern "C" DECLSPEC char* liq_str_concat(const char* a, const char* b);
+
+/*! Compares two strings like strcmp, the result is -1, 0 or 1. */
+extern "C" DECLSPEC int64_t liq_str_compare(const char* a, const char* b);
+
+/*! Returns 1 if both strings are equal otherwise 0. */
+extern "C" DECLSPEC int64_t liq_str_equal(const char* a, const char* b);
+
+/*! Returns the FNV-1a hash of a string. */
+extern "C" DECLSPEC int64_t liq_str_hash(const char* str);
+
+/*! Returns count characters starting at begin, both are clamped to the string. */
+extern "C" DECLSPEC char* liq_str_substr(const char* str, int64_t begin, int64_t count);
+
+/*
+ *! Hash maps (map<K,V>), see buildins_map.cpp
+ *  There is a variant of each function for the keys int (_i64), double (_f64) and string (_str).
+ *  The values are passed as 64 bit word, the code generator converts them from and into the value type.
+ */
+
+/*! Returns a new empty map. */
+extern "C" DECLSPEC void* liq_map_new_i64();
+extern "C" DECLSPEC void* liq_map_new_f64();
+extern "C" DECLSPEC void* liq_map_new_str();
+
+/*! Frees a map created by liq_map_new. */
+extern "C" DECLSPEC void liq_map_free_i64(void* map);
+extern "C" DECLSPEC void liq_map_free_f64(void* map);
+extern "C" DECLSPEC void liq_map_free_str(void* map);
+
+/*! Returns the count of entries. */
+extern "C" DECLSPEC int64_t liq_map_len(const void* map);
+
+/*! Inserts the key or replaces its value. */
+extern "C" DECLSPEC void liq_map_put_i64(void* map, int64_t key, int64_t value);
+extern "C" DECLSPEC void liq_map_put_f64(void* map, double key, int64_t value);
+extern "C" DECLSPEC void liq_map_put_str(void* map, const char* key, int64_t value);
+
+/*! Returns the value of the key or defaultValue if the key isn't in the map. */
+extern "C" DECLSPEC int64_t liq_map_get_i64(void* map, int64_t key, int64_t defaultValue);
+extern "C" DECLSPEC int64_t liq_map_get_f64(void* map, double key, int64_t defaultValue);
+extern "C" DECLSPEC int64_t liq_map_get_str(void* map, const char* key, int64_t defaultValue);
+
+/*! Returns 1 if the key is in the map otherwise 0. */
+extern "C" DECLSPEC int64_t liq_map_contains_i64(void* map, int64_t key);
+extern "C" DECLSPEC int64_t liq_map_contains_f64(void* map, double key);
+extern "C" DECLSPEC int64_t liq_map_contains_str(void* map, const char* key);
+
+/*! Removes the key, returns 1 if it was in the map otherwise 0. */
+extern "C" DECLSPEC int64_t liq_map_remove_i64(void* map, int64_t key);
+extern "C" DECLSPEC int64_t liq_map_remove_f64(void* map, double key);
+extern "C" DECLSPEC int64_t liq_map_remove_str(void* map, const char* key);
+
+/*
+ *! Pool of the class objects, see buildins_pool.cpp
+ */
+
+/*! Allocates an uninitialized object of size bytes from the pool of the current thread. */
+extern "C" DECLSPEC void* liq_pool_alloc(int64_t size);
+
+/*! Gives an object back to the pool, size is the one it was allocated with. */
+extern "C" DECLSPEC void liq_pool_free(void* object, int64_t size);
+
+/*! Releases all objects of the pool of the current thread at once. */
+extern "C" DECLSPEC void liq_pool_release();
+
+/*
+ *! Struct of arrays (soa<Class>), see buildins_soa.cpp
+ */
+
+/*! Returns a new empty table with columnCount columns of 64 bit elements. */
+extern "C" DECLSPEC void* liq_soa_new(int64_t columnCount);
+
+/*! Adds a record with uninitialized elements, returns its index. The columns may be moved. */
+extern "C" DECLSPEC int64_t liq_soa_append(void* soa);
+
+/*! Frees a table created by liq_soa_new, nothing is done for nullptr. */
+extern "C" DECLSPEC void liq_soa_free(void* soa);
+
+/*! Queues the function with the index function to be optimized in the background (-m tiered), see TieredCompiler. */
+extern "C" DECLSPEC void liq_tier_up(int64_t function);
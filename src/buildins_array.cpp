@@ -0,0 +1,556 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LIQ_AVX2_DISPATCH 1
+#define LIQ_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#include <immintrin.h>
+#define LIQ_AVX2_STATIC 1
+#define LIQ_TARGET_AVX2
+#endif
+
+#include "buildins.h"
+
+/*
+ * Kernels of the typed numeric arrays (int[], double[]).
+ * Each kernel has a scalar implementation and, where it pays off, an AVX2 one.
+ * The AVX2 variant is selected at run time (gcc/clang) or at compile time (MSVC /arch:AVX2).
+ * Unaligned loads are used throughout since slices of an array don't keep the alignment.
+ *
+ * The code generator frees the storage of an array, which is only used by its variable or by the
+ * expression creating it (see CodeGenContext::freeArrays).
+ */
+
+namespace
+{
+constexpr size_t arrayAlignment = 64; ///< Cache line alignment of the array storage.
+
+void freeStorage(void* data)
+{
+#if defined(_MSC_VER)
+   _aligned_free(data);
+#else
+   std::free(data);
+#endif
+}
+
+#if defined(LIQ_AVX2_DISPATCH)
+/*! Detected when the runtime is loaded, so the kernels declared readonly by the code generator
+ *  don't initialize a static of their own on the first call.
+ */
+const bool avx2 = [] {
+   // Static initialization may run before the cpu model of libgcc is initialized.
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+}();
+
+bool hasAVX2() { return avx2; }
+#elif defined(LIQ_AVX2_STATIC)
+constexpr bool hasAVX2() { return true; }
+#endif
+
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+LIQ_TARGET_AVX2 double hsum(__m256d v)
+{
+   __m128d lo = _mm256_castpd256_pd128(v);
+   __m128d hi = _mm256_extractf128_pd(v, 1);
+   lo         = _mm_add_pd(lo, hi);
+   __m128d sh = _mm_unpackhi_pd(lo, lo);
+   return _mm_cvtsd_f64(_mm_add_sd(lo, sh));
+}
+
+LIQ_TARGET_AVX2 double sumAVX2(const double* a, int64_t n)
+{
+   __m256d acc0 = _mm256_setzero_pd();
+   __m256d acc1 = _mm256_setzero_pd();
+   int64_t i    = 0;
+   for (; i + 8 <= n; i += 8) {
+      acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+      acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+   }
+   double sum = hsum(_mm256_add_pd(acc0, acc1));
+   for (; i < n; ++i) {
+      sum += a[i];
+   }
+   return sum;
+}
+
+LIQ_TARGET_AVX2 int64_t sumAVX2(const int64_t* a, int64_t n)
+{
+   __m256i acc = _mm256_setzero_si256();
+   int64_t i   = 0;
+   for (; i + 4 <= n; i += 4) {
+      acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+   }
+   alignas(32) int64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+   int64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+   for (; i < n; ++i) {
+      sum += a[i];
+   }
+   return sum;
+}
+
+LIQ_TARGET_AVX2 double dotAVX2(const double* a, const double* b, int64_t n)
+{
+   __m256d acc0 = _mm256_setzero_pd();
+   __m256d acc1 = _mm256_setzero_pd();
+   int64_t i    = 0;
+   for (; i + 8 <= n; i += 8) {
+      acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+      acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+   }
+   double sum = hsum(_mm256_add_pd(acc0, acc1));
+   for (; i < n; ++i) {
+      sum += a[i] * b[i];
+   }
+   return sum;
+}
+
+LIQ_TARGET_AVX2 double minAVX2(const double* a, int64_t n)
+{
+   __m256d acc = _mm256_set1_pd(a[0]);
+   int64_t i   = 0;
+   for (; i + 4 <= n; i += 4) {
+      acc = _mm256_min_pd(acc, _mm256_loadu_pd(a + i));
+   }
+   alignas(32) double lanes[4];
+   _mm256_store_pd(lanes, acc);
+   double m = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+   for (; i < n; ++i) {
+      m = std::min(m, a[i]);
+   }
+   return m;
+}
+
+LIQ_TARGET_AVX2 double maxAVX2(const double* a, int64_t n)
+{
+   __m256d acc = _mm256_set1_pd(a[0]);
+   int64_t i   = 0;
+   for (; i + 4 <= n; i += 4) {
+      acc = _mm256_max_pd(acc, _mm256_loadu_pd(a + i));
+   }
+   alignas(32) double lanes[4];
+   _mm256_store_pd(lanes, acc);
+   double m = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+   for (; i < n; ++i) {
+      m = std::max(m, a[i]);
+   }
+   return m;
+}
+
+LIQ_TARGET_AVX2 int64_t minAVX2(const int64_t* a, int64_t n)
+{
+   __m256i acc = _mm256_set1_epi64x(a[0]);
+   int64_t i   = 0;
+   for (; i + 4 <= n; i += 4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      acc       = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+   }
+   alignas(32) int64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+   int64_t m = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+   for (; i < n; ++i) {
+      m = std::min(m, a[i]);
+   }
+   return m;
+}
+
+LIQ_TARGET_AVX2 int64_t maxAVX2(const int64_t* a, int64_t n)
+{
+   __m256i acc = _mm256_set1_epi64x(a[0]);
+   int64_t i   = 0;
+   for (; i + 4 <= n; i += 4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      acc       = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+   }
+   alignas(32) int64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+   int64_t m = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+   for (; i < n; ++i) {
+      m = std::max(m, a[i]);
+   }
+   return m;
+}
+
+LIQ_TARGET_AVX2 void axpyAVX2(double* out, double a, const double* x, const double* y, int64_t n)
+{
+   __m256d va = _mm256_set1_pd(a);
+   int64_t i  = 0;
+   for (; i + 4 <= n; i += 4) {
+      _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + i)), _mm256_loadu_pd(y + i)));
+   }
+   for (; i < n; ++i) {
+      out[i] = a * x[i] + y[i];
+   }
+}
+
+LIQ_TARGET_AVX2 void scaleAVX2(double* out, double a, const double* x, int64_t n)
+{
+   __m256d va = _mm256_set1_pd(a);
+   int64_t i  = 0;
+   for (; i + 4 <= n; i += 4) {
+      _mm256_storeu_pd(out + i, _mm256_mul_pd(va, _mm256_loadu_pd(x + i)));
+   }
+   for (; i < n; ++i) {
+      out[i] = a * x[i];
+   }
+}
+
+/*! Vector and scalar form of one element-wise operation. */
+struct AddPd {
+   LIQ_TARGET_AVX2 __m256d operator()(__m256d a, __m256d b) const { return _mm256_add_pd(a, b); }
+   double operator()(double a, double b) const { return a + b; }
+};
+struct SubPd {
+   LIQ_TARGET_AVX2 __m256d operator()(__m256d a, __m256d b) const { return _mm256_sub_pd(a, b); }
+   double operator()(double a, double b) const { return a - b; }
+};
+struct MulPd {
+   LIQ_TARGET_AVX2 __m256d operator()(__m256d a, __m256d b) const { return _mm256_mul_pd(a, b); }
+   double operator()(double a, double b) const { return a * b; }
+};
+struct DivPd {
+   LIQ_TARGET_AVX2 __m256d operator()(__m256d a, __m256d b) const { return _mm256_div_pd(a, b); }
+   double operator()(double a, double b) const { return a / b; }
+};
+struct AddEpi64 {
+   LIQ_TARGET_AVX2 __m256i operator()(__m256i a, __m256i b) const { return _mm256_add_epi64(a, b); }
+   int64_t operator()(int64_t a, int64_t b) const { return a + b; }
+};
+struct SubEpi64 {
+   LIQ_TARGET_AVX2 __m256i operator()(__m256i a, __m256i b) const { return _mm256_sub_epi64(a, b); }
+   int64_t operator()(int64_t a, int64_t b) const { return a - b; }
+};
+
+template <typename Op>
+LIQ_TARGET_AVX2 void elementwiseAVX2(double* out, const double* a, const double* b, int64_t n, Op op)
+{
+   int64_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      _mm256_storeu_pd(out + i, op(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+   }
+   for (; i < n; ++i) {
+      out[i] = op(a[i], b[i]);
+   }
+}
+
+template <typename Op>
+LIQ_TARGET_AVX2 void elementwiseAVX2(int64_t* out, const int64_t* a, const int64_t* b, int64_t n, Op op)
+{
+   int64_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), op(va, vb));
+   }
+   for (; i < n; ++i) {
+      out[i] = op(a[i], b[i]);
+   }
+}
+#endif
+
+template <typename T>
+T sumScalar(const T* a, int64_t n)
+{
+   T sum = 0;
+   for (int64_t i = 0; i < n; ++i) {
+      sum += a[i];
+   }
+   return sum;
+}
+
+template <typename T>
+T dotScalar(const T* a, const T* b, int64_t n)
+{
+   T sum = 0;
+   for (int64_t i = 0; i < n; ++i) {
+      sum += a[i] * b[i];
+   }
+   return sum;
+}
+
+template <typename T>
+T minScalar(const T* a, int64_t n)
+{
+   T m = a[0];
+   for (int64_t i = 1; i < n; ++i) {
+      m = std::min(m, a[i]);
+   }
+   return m;
+}
+
+template <typename T>
+T maxScalar(const T* a, int64_t n)
+{
+   T m = a[0];
+   for (int64_t i = 1; i < n; ++i) {
+      m = std::max(m, a[i]);
+   }
+   return m;
+}
+
+template <typename T, typename Op>
+void elementwiseScalar(T* out, const T* a, const T* b, int64_t n, Op op)
+{
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = op(a[i], b[i]);
+   }
+}
+
+} // namespace
+
+extern "C" DECLSPEC void* liq_array_alloc(int64_t count, int64_t elemSize)
+{
+   size_t bytes = static_cast<size_t>(std::max<int64_t>(count, 1) * elemSize);
+   // aligned_alloc requires a multiple of the alignment.
+   bytes = (bytes + arrayAlignment - 1) & ~(arrayAlignment - 1);
+#if defined(_MSC_VER)
+   void* data = _aligned_malloc(bytes, arrayAlignment);
+#else
+   void* data = std::aligned_alloc(arrayAlignment, bytes);
+#endif
+   if (data == nullptr) {
+      liq_runtime_error("out of memory");
+   }
+   return data;
+}
+
+extern "C" DECLSPEC void liq_array_free(void* data)
+{
+   freeStorage(data);
+}
+
+extern "C" DECLSPEC int64_t liq_sum_i64(const int64_t* a, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return sumAVX2(a, n);
+   }
+#endif
+   return sumScalar(a, n);
+}
+
+extern "C" DECLSPEC double liq_sum_f64(const double* a, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return sumAVX2(a, n);
+   }
+#endif
+   return sumScalar(a, n);
+}
+
+extern "C" DECLSPEC int64_t liq_min_i64(const int64_t* a, int64_t n)
+{
+   if (n <= 0) {
+      return 0;
+   }
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return minAVX2(a, n);
+   }
+#endif
+   return minScalar(a, n);
+}
+
+extern "C" DECLSPEC double liq_min_f64(const double* a, int64_t n)
+{
+   if (n <= 0) {
+      return 0.;
+   }
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return minAVX2(a, n);
+   }
+#endif
+   return minScalar(a, n);
+}
+
+extern "C" DECLSPEC int64_t liq_max_i64(const int64_t* a, int64_t n)
+{
+   if (n <= 0) {
+      return 0;
+   }
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return maxAVX2(a, n);
+   }
+#endif
+   return maxScalar(a, n);
+}
+
+extern "C" DECLSPEC double liq_max_f64(const double* a, int64_t n)
+{
+   if (n <= 0) {
+      return 0.;
+   }
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return maxAVX2(a, n);
+   }
+#endif
+   return maxScalar(a, n);
+}
+
+extern "C" DECLSPEC int64_t liq_dot_i64(const int64_t* a, const int64_t* b, int64_t n)
+{
+   // AVX2 has no 64 bit multiply, the compiler does a better job on the plain loop.
+   return dotScalar(a, b, n);
+}
+
+extern "C" DECLSPEC double liq_dot_f64(const double* a, const double* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      return dotAVX2(a, b, n);
+   }
+#endif
+   return dotScalar(a, b, n);
+}
+
+extern "C" DECLSPEC void liq_axpy_i64(int64_t* out, int64_t a, const int64_t* x, const int64_t* y, int64_t n)
+{
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = a * x[i] + y[i];
+   }
+}
+
+extern "C" DECLSPEC void liq_axpy_f64(double* out, double a, const double* x, const double* y, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      axpyAVX2(out, a, x, y, n);
+      return;
+   }
+#endif
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = a * x[i] + y[i];
+   }
+}
+
+extern "C" DECLSPEC void liq_scale_i64(int64_t* out, int64_t a, const int64_t* x, int64_t n)
+{
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = a * x[i];
+   }
+}
+
+extern "C" DECLSPEC void liq_scale_f64(double* out, double a, const double* x, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      scaleAVX2(out, a, x, n);
+      return;
+   }
+#endif
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = a * x[i];
+   }
+}
+
+extern "C" DECLSPEC void liq_add_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, AddEpi64());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](int64_t x, int64_t y) { return x + y; });
+}
+
+extern "C" DECLSPEC void liq_sub_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, SubEpi64());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](int64_t x, int64_t y) { return x - y; });
+}
+
+extern "C" DECLSPEC void liq_mul_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n)
+{
+   elementwiseScalar(out, a, b, n, [](int64_t x, int64_t y) { return x * y; });
+}
+
+extern "C" DECLSPEC void liq_div_i64(int64_t* out, const int64_t* a, const int64_t* b, int64_t n)
+{
+   elementwiseScalar(out, a, b, n, [](int64_t x, int64_t y) {
+      if (y == 0) {
+         liq_runtime_error("integer division by zero");
+      }
+      return x / y;
+   });
+}
+
+extern "C" DECLSPEC void liq_add_f64(double* out, const double* a, const double* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, AddPd());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](double x, double y) { return x + y; });
+}
+
+extern "C" DECLSPEC void liq_sub_f64(double* out, const double* a, const double* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, SubPd());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](double x, double y) { return x - y; });
+}
+
+extern "C" DECLSPEC void liq_mul_f64(double* out, const double* a, const double* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, MulPd());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](double x, double y) { return x * y; });
+}
+
+extern "C" DECLSPEC void liq_div_f64(double* out, const double* a, const double* b, int64_t n)
+{
+#if defined(LIQ_AVX2_DISPATCH) || defined(LIQ_AVX2_STATIC)
+   if (hasAVX2()) {
+      elementwiseAVX2(out, a, b, n, DivPd());
+      return;
+   }
+#endif
+   elementwiseScalar(out, a, b, n, [](double x, double y) { return x / y; });
+}
+
+extern "C" DECLSPEC void liq_fill_i64(int64_t* out, int64_t value, int64_t n)
+{
+   std::fill(out, out + std::max<int64_t>(n, 0), value);
+}
+
+extern "C" DECLSPEC void liq_fill_f64(double* out, double value, int64_t n)
+{
+   std::fill(out, out + std::max<int64_t>(n, 0), value);
+}
+
+extern "C" DECLSPEC void liq_cvt_i64_f64(double* out, const int64_t* in, int64_t n)
+{
+   for (int64_t i = 0; i < n; ++i) {
+      out[i] = static_cast<double>(in[i]);
+   }
+}
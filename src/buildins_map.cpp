@@ -0,0 +1,260 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "buildins.h"
+
+/*
+ * Runtime of the hash map type (map<K,V>).
+ * The table uses open addressing with Robin Hood hashing: an entry is stored at the first free
+ * slot after its home slot, but it takes the slot of an entry which is closer to its own home.
+ * So the probe distances stay short and a lookup can stop as soon as it meets an entry, which is
+ * closer to its home than the key would be.
+ *
+ * The probe distances (+1, 0 is a free slot) are kept in a byte array apart from the entries,
+ * a lookup scans them linearly and touches the entries only on a matching distance.
+ * A removed entry is not marked, the following entries are shifted back instead.
+ *
+ * The keys and the values are stored as 64 bit words. The code generator converts the values
+ * of the map type (int, double, boolean or string) from and into a word, so nothing is boxed.
+ * The keys are either integers, doubles (stored as bits) or strings (stored as pointer).
+ */
+
+namespace
+{
+/*! The part shared by all key types, liq_map_len reads it. */
+struct MapBase
+{
+   int64_t count{0};
+};
+
+struct Entry
+{
+   uint64_t key;
+   int64_t  value;
+};
+
+/*! Spreads the bits of a hash over the low bits, which select the slot (Fibonacci hashing). */
+inline uint64_t mix(uint64_t hash)
+{
+   hash *= 0x9e3779b97f4a7c15ull;
+   return hash ^ (hash >> 32);
+}
+
+/*! Integer and double keys, doubles are compared by their bits. */
+struct WordKey
+{
+   static uint64_t hash(uint64_t key) { return mix(key); }
+   static bool     equal(uint64_t a, uint64_t b) { return a == b; }
+};
+
+/*! String keys, compared by their characters. */
+struct StringKey
+{
+   static const char* str(uint64_t key) { return reinterpret_cast<const char*>(static_cast<uintptr_t>(key)); }
+   static uint64_t    hash(uint64_t key) { return mix(static_cast<uint64_t>(liq_str_hash(str(key)))); }
+   static bool        equal(uint64_t a, uint64_t b) { return liq_str_equal(str(a), str(b)) != 0; }
+};
+
+template <class Key>
+class HashMap : public MapBase
+{
+public:
+   HashMap() = default;
+   HashMap(const HashMap&) = delete;
+   HashMap& operator=(const HashMap&) = delete;
+   ~HashMap()
+   {
+      std::free(distances);
+      std::free(entries);
+   }
+
+   bool contains(uint64_t key) const { return find(key) != npos; }
+
+   int64_t get(uint64_t key, int64_t defaultValue) const
+   {
+      size_t index = find(key);
+      return index != npos ? entries[index].value : defaultValue;
+   }
+
+   void put(uint64_t key, int64_t value)
+   {
+      size_t index = find(key);
+      if( index != npos ) {
+         entries[index].value = value;
+         return;
+      }
+      // The load factor is kept below 7/8.
+      if( static_cast<size_t>(count + 1) * 8 > capacity() * 7 ) {
+         grow();
+      }
+      insert({key, value});
+   }
+
+   bool remove(uint64_t key)
+   {
+      size_t index = find(key);
+      if( index == npos ) {
+         return false;
+      }
+      // Shift the following entries back, until one is at its home slot or a slot is free.
+      size_t next = (index + 1) & mask;
+      while( distances[next] > 1 ) {
+         distances[index] = distances[next] - 1;
+         entries[index]   = entries[next];
+         index            = next;
+         next             = (next + 1) & mask;
+      }
+      distances[index] = 0;
+      --count;
+      return true;
+   }
+
+private:
+   static constexpr size_t   npos            = ~size_t(0);
+   static constexpr size_t   initialCapacity = 16;
+   static constexpr unsigned maxDistance     = 255;
+
+   size_t capacity() const { return distances != nullptr ? mask + 1 : 0; }
+
+   /*! Returns the slot of the key or npos. */
+   size_t find(uint64_t key) const
+   {
+      if( count == 0 ) {
+         return npos;
+      }
+      size_t index = Key::hash(key) & mask;
+      for( unsigned distance = 1;; ++distance ) {
+         unsigned other = distances[index];
+         if( other < distance ) {
+            // A free slot or an entry closer to its home, the key would have taken its slot.
+            return npos;
+         }
+         if( other == distance && Key::equal(entries[index].key, key) ) {
+            return index;
+         }
+         index = (index + 1) & mask;
+      }
+   }
+
+   /*! Inserts an entry, whose key isn't in the table. */
+   void insert(Entry entry)
+   {
+      size_t   index    = Key::hash(entry.key) & mask;
+      unsigned distance = 1;
+      for( ;; ) {
+         unsigned other = distances[index];
+         if( other == 0 ) {
+            distances[index] = static_cast<uint8_t>(distance);
+            entries[index]   = entry;
+            ++count;
+            return;
+         }
+         if( other < distance ) {
+            // Take the slot from the entry closer to its home and go on with that one.
+            distances[index] = static_cast<uint8_t>(distance);
+            std::swap(entries[index], entry);
+            distance = other;
+         }
+         index = (index + 1) & mask;
+         if( ++distance > maxDistance ) {
+            // Only a very bad hash gets here, more slots spread the entries.
+            grow();
+            insert(entry);
+            return;
+         }
+      }
+   }
+
+   void grow()
+   {
+      size_t   oldCapacity  = capacity();
+      uint8_t* oldDistances = distances;
+      Entry*   oldEntries   = entries;
+      size_t   newCapacity  = oldCapacity != 0 ? oldCapacity * 2 : initialCapacity;
+
+      distances = static_cast<uint8_t*>(std::calloc(newCapacity, sizeof(uint8_t)));
+      entries   = static_cast<Entry*>(std::malloc(newCapacity * sizeof(Entry)));
+      if( distances == nullptr || entries == nullptr ) {
+         liq_runtime_error("out of memory");
+      }
+      mask  = newCapacity - 1;
+      count = 0;
+      for( size_t i = 0; i < oldCapacity; ++i ) {
+         if( oldDistances[i] != 0 ) {
+            insert(oldEntries[i]);
+         }
+      }
+      std::free(oldDistances);
+      std::free(oldEntries);
+   }
+
+   uint8_t* distances{nullptr};
+   Entry*   entries{nullptr};
+   size_t   mask{0};
+};
+
+using WordMap   = HashMap<WordKey>;
+using StringMap = HashMap<StringKey>;
+
+inline WordMap*   wordMap(void* map) { return static_cast<WordMap*>(static_cast<MapBase*>(map)); }
+inline StringMap* stringMap(void* map) { return static_cast<StringMap*>(static_cast<MapBase*>(map)); }
+
+/*! The bits of a double key, -0.0 is the same key as 0.0. */
+inline uint64_t doubleKey(double key)
+{
+   if( key == 0.0 ) {
+      key = 0.0;
+   }
+   uint64_t bits;
+   std::memcpy(&bits, &key, sizeof(bits));
+   return bits;
+}
+
+inline uint64_t stringKey(const char* key) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)); }
+
+template <typename Map> void* newMap()
+{
+   auto map = new (std::nothrow) Map();
+   if( map == nullptr ) {
+      liq_runtime_error("out of memory");
+   }
+   return static_cast<MapBase*>(map);
+}
+} // namespace
+
+extern "C" DECLSPEC void* liq_map_new_i64() { return newMap<WordMap>(); }
+extern "C" DECLSPEC void* liq_map_new_f64() { return newMap<WordMap>(); }
+extern "C" DECLSPEC void* liq_map_new_str() { return newMap<StringMap>(); }
+
+extern "C" DECLSPEC void liq_map_free_i64(void* map) { delete wordMap(map); }
+extern "C" DECLSPEC void liq_map_free_f64(void* map) { delete wordMap(map); }
+extern "C" DECLSPEC void liq_map_free_str(void* map) { delete stringMap(map); }
+
+extern "C" DECLSPEC int64_t liq_map_len(const void* map) { return static_cast<const MapBase*>(map)->count; }
+
+extern "C" DECLSPEC void liq_map_put_i64(void* map, int64_t key, int64_t value) { wordMap(map)->put(static_cast<uint64_t>(key), value); }
+extern "C" DECLSPEC void liq_map_put_f64(void* map, double key, int64_t value) { wordMap(map)->put(doubleKey(key), value); }
+extern "C" DECLSPEC void liq_map_put_str(void* map, const char* key, int64_t value) { stringMap(map)->put(stringKey(key), value); }
+
+extern "C" DECLSPEC int64_t liq_map_get_i64(void* map, int64_t key, int64_t defaultValue)
+{
+   return wordMap(map)->get(static_cast<uint64_t>(key), defaultValue);
+}
+
+extern "C" DECLSPEC int64_t liq_map_get_f64(void* map, double key, int64_t defaultValue) { return wordMap(map)->get(doubleKey(key), defaultValue); }
+
+extern "C" DECLSPEC int64_t liq_map_get_str(void* map, const char* key, int64_t defaultValue)
+{
+   return stringMap(map)->get(stringKey(key), defaultValue);
+}
+
+extern "C" DECLSPEC int64_t liq_map_contains_i64(void* map, int64_t key) { return wordMap(map)->contains(static_cast<uint64_t>(key)); }
+extern "C" DECLSPEC int64_t liq_map_contains_f64(void* map, double key) { return wordMap(map)->contains(doubleKey(key)); }
+extern "C" DECLSPEC int64_t liq_map_contains_str(void* map, const char* key) { return stringMap(map)->contains(stringKey(key)); }
+
+extern "C" DECLSPEC int64_t liq_map_remove_i64(void* map, int64_t key) { return wordMap(map)->remove(static_cast<uint64_t>(key)); }
+extern "C" DECLSPEC int64_t liq_map_remove_f64(void* map, double key) { return wordMap(map)->remove(doubleKey(key)); }
+extern "C" DECLSPEC int64_t liq_map_remove_str(void* map, const char* key) { return stringMap(map)->remove(stringKey(key)); }
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "buildins.h"
+
+/*
+ * Pool allocator of the class objects.
+ * The objects are grouped by their size into size classes of 16 byte steps, so all objects of a
+ * class of the script come from the same size class. Each size class carves its objects out of
+ * chunks and keeps the freed ones in a free list. Pool, chunks and free lists are per thread, so
+ * no locking is needed. The objects are not freed one by one, the chunks are released all at once
+ * when the script has been run.
+ */
+
+namespace
+{
+constexpr size_t granularity    = 16;
+constexpr size_t sizeClassCount = 32; // up to 512 bytes, larger objects are allocated one by one
+constexpr size_t chunkSize      = 64 * 1024;
+
+struct FreeObject
+{
+   FreeObject* next;
+};
+
+struct SizeClass
+{
+   FreeObject* freeList{nullptr};
+   char*       next{nullptr};
+   char*       end{nullptr};
+};
+
+class Pool
+{
+public:
+   ~Pool() { release(); }
+
+   void* allocate(size_t size)
+   {
+      size_t index = sizeClassOf(size);
+      if( index >= sizeClassCount ) {
+         return newChunk(size);
+      }
+      auto& sizeClass = sizeClasses[index];
+      if( sizeClass.freeList != nullptr ) {
+         auto object        = sizeClass.freeList;
+         sizeClass.freeList = object->next;
+         return object;
+      }
+      size_t objectSize = (index + 1) * granularity;
+      if( sizeClass.next == nullptr || sizeClass.next + objectSize > sizeClass.end ) {
+         sizeClass.next = static_cast<char*>(newChunk(chunkSize));
+         sizeClass.end  = sizeClass.next + chunkSize;
+      }
+      auto object = sizeClass.next;
+      sizeClass.next += objectSize;
+      return object;
+   }
+
+   void free(void* object, size_t size)
+   {
+      size_t index = sizeClassOf(size);
+      if( object == nullptr || index >= sizeClassCount ) {
+         // A large object stays until the release.
+         return;
+      }
+      auto freeObject             = static_cast<FreeObject*>(object);
+      freeObject->next            = sizeClasses[index].freeList;
+      sizeClasses[index].freeList = freeObject;
+   }
+
+   void release()
+   {
+      for( auto chunk : chunks ) {
+         std::free(chunk);
+      }
+      chunks.clear();
+      for( auto& sizeClass : sizeClasses ) {
+         sizeClass = SizeClass();
+      }
+   }
+
+private:
+   static size_t sizeClassOf(size_t size) { return size == 0 ? 0 : (size - 1) / granularity; }
+
+   void* newChunk(size_t size)
+   {
+      // malloc returns memory aligned for any type, which is at least the granularity.
+      auto chunk = std::malloc(size);
+      if( chunk == nullptr ) {
+         liq_runtime_error("out of memory");
+      }
+      try {
+         chunks.push_back(chunk);
+      } catch( const std::bad_alloc& ) {
+         liq_runtime_error("out of memory");
+      }
+      return chunk;
+   }
+
+   SizeClass          sizeClasses[sizeClassCount];
+   std::vector<void*> chunks;
+};
+
+thread_local Pool pool;
+} // namespace
+
+extern "C" DECLSPEC void* liq_pool_alloc(int64_t size) { return pool.allocate(static_cast<size_t>(size)); }
+
+extern "C" DECLSPEC void liq_pool_free(void* object, int64_t size) { pool.free(object, static_cast<size_t>(size)); }
+
+extern "C" DECLSPEC void liq_pool_release() { pool.release(); }
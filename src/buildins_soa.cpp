@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "buildins.h"
+
+/*
+ * Runtime of the struct of arrays type (soa<Class>).
+ * Each instance variable of the class is stored in a column of its own, so a pass over one
+ * instance variable reads contiguous memory. All columns have elements of 64 bit (int, double
+ * and boolean, which is stored as int), the code generator reads and writes the elements itself.
+ *
+ *   | length | capacity | column count | column 0 | column 1 | ... |
+ *
+ * The code generator knows this layout, it reads the length and the columns directly.
+ */
+
+namespace
+{
+constexpr int64_t initialCapacity = 64;
+
+struct SoaTable
+{
+   int64_t length;
+   int64_t capacity;
+   int64_t columnCount;
+   void*   columns[1];
+};
+
+size_t tableSize(int64_t columnCount) { return sizeof(SoaTable) + sizeof(void*) * (columnCount > 0 ? columnCount - 1 : 0); }
+} // namespace
+
+extern "C" DECLSPEC void* liq_soa_new(int64_t columnCount)
+{
+   auto table = static_cast<SoaTable*>(std::calloc(1, tableSize(columnCount)));
+   if( table == nullptr ) {
+      liq_runtime_error("out of memory");
+   }
+   table->columnCount = columnCount;
+   return table;
+}
+
+extern "C" DECLSPEC int64_t liq_soa_append(void* soa)
+{
+   auto table = static_cast<SoaTable*>(soa);
+   if( table->length == table->capacity ) {
+      int64_t capacity = table->capacity != 0 ? table->capacity * 2 : initialCapacity;
+      for( int64_t i = 0; i < table->columnCount; ++i ) {
+         auto column = std::realloc(table->columns[i], capacity * sizeof(int64_t));
+         if( column == nullptr ) {
+            liq_runtime_error("out of memory");
+         }
+         table->columns[i] = column;
+      }
+      table->capacity = capacity;
+   }
+   return table->length++;
+}
+
+extern "C" DECLSPEC void liq_soa_free(void* soa)
+{
+   auto table = static_cast<SoaTable*>(soa);
+   if( table == nullptr ) {
+      return;
+   }
+   for( int64_t i = 0; i < table->columnCount; ++i ) {
+      std::free(table->columns[i]);
+   }
+   std::free(table);
+}
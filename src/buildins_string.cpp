@@ -0,0 +1,170 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#if !defined(LIQ_BITCODE_RUNTIME)
+#include <new>
+#include <vector>
+#endif
+
+#include "buildins.h"
+
+/*
+ * Runtime of the string type.
+ * A string is a pointer to NUL terminated characters, preceded by a header holding the
+ * capacity and the length. So a string can be passed to printf like functions as it is,
+ * while the length is known without scanning the characters.
+ *
+ *   | capacity | length | c h a r s ... \0 |
+ *                       ^ string pointer
+ *
+ * Strings are immutable. The literals are emitted as constants by the code generator with
+ * the same layout and a capacity of 0. The ones created at run time are allocated from an
+ * arena, since they are small and never freed individually. The arena is released when the script has been run.
+ *
+ * The file is also compiled to bitcode (LIQ_BITCODE_RUNTIME), which is linked into the scripts.
+ * The bitcode has no state, the allocation is left to the native liq_str_alloc.
+ */
+
+namespace
+{
+struct StringHeader
+{
+   int64_t capacity;
+   int64_t length;
+};
+
+#if !defined(LIQ_BITCODE_RUNTIME)
+constexpr size_t arenaChunkSize = 64 * 1024;
+
+/*! Bump allocator for the strings created at run time. */
+class StringArena
+{
+public:
+   ~StringArena() { release(); }
+
+   void release()
+   {
+      for (auto chunk : chunks) {
+         std::free(chunk);
+      }
+      chunks.clear();
+      next = nullptr;
+      end  = nullptr;
+   }
+
+   void* allocate(size_t bytes)
+   {
+      bytes = (bytes + alignof(StringHeader) - 1) & ~(alignof(StringHeader) - 1);
+      if (bytes > arenaChunkSize / 4) {
+         // A large string gets its own chunk, the current one is continued afterwards.
+         return newChunk(bytes);
+      }
+      if (next == nullptr || next + bytes > end) {
+         auto chunk = static_cast<char*>(newChunk(arenaChunkSize));
+         next = chunk;
+         end  = chunk + arenaChunkSize;
+      }
+      auto memory = next;
+      next += bytes;
+      return memory;
+   }
+
+private:
+   void* newChunk(size_t bytes)
+   {
+      auto chunk = std::malloc(bytes);
+      if (chunk == nullptr) {
+         liq_runtime_error("out of memory");
+      }
+      try {
+         chunks.push_back(chunk);
+      } catch (const std::bad_alloc&) {
+         liq_runtime_error("out of memory");
+      }
+      return chunk;
+   }
+
+   std::vector<void*> chunks;
+   char*              next{nullptr};
+   char*              end{nullptr};
+};
+
+StringArena arena;
+#endif
+
+inline const StringHeader* header(const char* str) { return reinterpret_cast<const StringHeader*>(str) - 1; }
+
+inline int64_t length(const char* str) { return header(str)->length; }
+} // namespace
+
+#if !defined(LIQ_BITCODE_RUNTIME)
+extern "C" DECLSPEC char* liq_str_alloc(int64_t length)
+{
+   auto head      = static_cast<StringHeader*>(arena.allocate(sizeof(StringHeader) + length + 1));
+   head->capacity = length;
+   head->length   = length;
+   auto str       = reinterpret_cast<char*>(head + 1);
+   str[length]    = '\0';
+   return str;
+}
+
+extern "C" DECLSPEC void liq_str_release() { arena.release(); }
+#endif
+
+extern "C" DECLSPEC int64_t liq_str_len(const char* str) { return length(str); }
+
+extern "C" DECLSPEC char* liq_str_concat(const char* a, const char* b)
+{
+   int64_t lenA = length(a);
+   int64_t lenB = length(b);
+   char*   str  = liq_str_alloc(lenA + lenB);
+   std::memcpy(str, a, lenA);
+   std::memcpy(str + lenA, b, lenB);
+   return str;
+}
+
+extern "C" DECLSPEC int64_t liq_str_compare(const char* a, const char* b)
+{
+   if (a == b) {
+      return 0;
+   }
+   int64_t lenA = length(a);
+   int64_t lenB = length(b);
+   int     cmp  = std::memcmp(a, b, std::min(lenA, lenB));
+   if (cmp != 0) {
+      return cmp < 0 ? -1 : 1;
+   }
+   return lenA < lenB ? -1 : (lenA > lenB ? 1 : 0);
+}
+
+extern "C" DECLSPEC int64_t liq_str_equal(const char* a, const char* b)
+{
+   // Interned literals are the same pointer, strings of different length never match.
+   return a == b || (length(a) == length(b) && std::memcmp(a, b, length(a)) == 0);
+}
+
+extern "C" DECLSPEC int64_t liq_str_hash(const char* str)
+{
+   // FNV-1a
+   uint64_t hash = 14695981039346656037ull;
+   for (int64_t i = 0, n = length(str); i < n; ++i) {
+      hash ^= static_cast<unsigned char>(str[i]);
+      hash *= 1099511628211ull;
+   }
+   return static_cast<int64_t>(hash);
+}
+
+extern "C" DECLSPEC char* liq_str_substr(const char* str, int64_t begin, int64_t count)
+{
+   int64_t len = length(str);
+   begin       = std::clamp<int64_t>(begin, 0, len);
+   count       = std::clamp<int64_t>(count, 0, len - begin);
+   if (begin == 0 && count == len) {
+      // Strings are immutable, so the whole string is shared.
+      return const_cast<char*>(str);
+   }
+   char* sub = liq_str_alloc(count);
+   std::memcpy(sub, str + begin, count);
+   return sub;
+}
@@ -0,0 +1,16 @@
+# Writes the bitcode file INPUT as byte array into the C++ source OUTPUT.
+# An empty INPUT results in an empty runtime, then nothing is linked into the scripts.
+if(INPUT)
+    file(READ ${INPUT} BYTES HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${BYTES}")
+    string(LENGTH "${BYTES}" SIZE)
+    math(EXPR SIZE "${SIZE} / 5")
+else()
+    set(BYTES "0")
+    set(SIZE 0)
+endif()
+file(WRITE ${OUTPUT}
+     "// Generated by embed_bitcode.cmake, don't edit.\n"
+     "#include <cstddef>\n"
+     "extern const unsigned char liqRuntimeBitcode[] = {${BYTES}};\n"
+     "extern const size_t liqRuntimeBitcodeSize = ${SIZE};\n")
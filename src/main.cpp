@@ -31,7 +31,10 @@ int main(int argc, char** argv)
    bool verbose = false;
    bool quiet = false;
    bool debug = false;
-   GetOpt getopt(argc, argv, "hi:vqd");
+   std::string vectorLibrary;
+   llvm::FastMathFlags fastMath;
+   liquid::CompileMode compileMode = liquid::CompileMode::Auto;
+   GetOpt getopt(argc, argv, "hi:vqdf:m:");
    for( auto opt : getopt ) {
       switch( opt ) {
          case 'i': {
@@ -54,6 +57,32 @@ int main(int argc, char** argv)
          case 'd':
             debug = true;
             break;
+         case 'f': {
+            std::string feature = getopt.get();
+            if( feature.compare(0, 9, "fast-math") == 0 ) {
+               if( !liquid::CodeGenContext::parseFastMath(feature, fastMath) ) {
+                  std::cout << "Unknown fast-math flag in -f " << feature << "\n";
+                  usage();
+                  return 1;
+               }
+            } else {
+               vectorLibrary = feature;
+            }
+         } break;
+         case 'm': {
+            std::string mode = getopt.get();
+            if( mode == "latency" ) {
+               compileMode = liquid::CompileMode::Latency;
+            } else if( mode == "throughput" ) {
+               compileMode = liquid::CompileMode::Throughput;
+            } else if( mode == "tiered" ) {
+               compileMode = liquid::CompileMode::Tiered;
+            } else if( mode != "auto" ) {
+               std::cout << "Unknown compile mode " << mode << "\n";
+               usage();
+               return 1;
+            }
+         } break;
          case 'h':
             usage();
             return 1;
@@ -93,6 +122,9 @@ int main(int argc, char** argv)
       liquid::CodeGenContext context(quiet ? devNull : std::cout);
       context.verbose = verbose;
       context.debug = debug;
+      context.vectorLibrary = vectorLibrary;
+      context.fastMath = fastMath;
+      context.compileMode = compileMode;
       if( verbose )
          context.printCodeGeneration(*programBlock, std::cout);
       if( context.preProcessing(*programBlock) ) {
@@ -112,10 +144,15 @@ int main(int argc, char** argv)
 void usage()
 {
    std::cout << "Usage:\n";
-   std::cout << "liq filename -h -d -v -q -i path1;path2\n";
+   std::cout << "liq filename -h -d -v -q -i path1;path2 -f libmvec -f fast-math -m latency\n";
    std::cout << "\t-h this help text.\n";
    std::cout << "\t-d debug code generation. Disables the code optimizer pass.\n";
    std::cout << "\t-v be more verbose.\n";
    std::cout << "\t-q be quiet.\n";
    std::cout << "\t-i semicolon separated list of import paths where additional liquid files are located.\n";
+   std::cout << "\t-f vector math library used to vectorize loops with math functions (libmvec).\n";
+   std::cout << "\t-f fast-math[=flag,...] fast-math flags of the double arithmetic (reassoc, contract, nnan, ninf, nsz, arcp, afn), all if none are listed.\n";
+   std::cout << "\t-m compile mode: latency (no optimizer, fast code generation), throughput (optimizer O2) or auto (default),\n";
+   std::cout << "\t   which takes latency for a small script without loops and recursion.\n";
+   std::cout << "\t   tiered starts like latency and optimizes the hot functions in the background.\n";
 }
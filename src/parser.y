@@ -19,6 +19,8 @@
     #include "MethodCall.h"
     #include "Declaration.h"
     #include "WhileLoop.h"
+    #include "LoopControl.h"
+    #include "Match.h"
     #include "Array.h"
     #include "Range.h"
 
@@ -65,6 +67,8 @@
     liquid::VariableDeclaration *var_decl;
     std::vector<liquid::VariableDeclaration*> *varvec;
     std::vector<liquid::Expression*> *exprvec;
+    liquid::MatchCase *match_case;
+    liquid::MatchCaseList *casevec;
     std::string *string;
     long long integer;
     double number;
@@ -76,7 +80,7 @@
    match our tokens.l lex file. We also define the node type
    they represent.
  */
-%token <string> TIDENTIFIER TSTR
+%token <string> TIDENTIFIER TSTR TANNOTATION
 %token <integer> TINTEGER
 %token <number> TDOUBLE
 %token <boolean> TBOOL
@@ -85,8 +89,8 @@
 %token <token> TRANGE
 %token <token> TPLUS TMINUS TMUL TDIV
 %token <token> TNOT TAND TOR
-%token <token> TIF TELSE TWHILE
-%token <token> TDEF TRETURN TVAR
+%token <token> TIF TTHEN TELSE TWHILE TBREAK TCONTINUE TMATCH TCASE
+%token <token> TDEF TRETURN TVAR TMAP TSOA
 %token <token> INDENT UNINDENT 
 
 /* Define the type of node our nonterminal symbols represent.
@@ -94,15 +98,18 @@
    we call an ident (defined by union type ident) we are really
    calling an (Identifier*). It makes the compiler happy.
  */
-%type <ident> ident
-%type <expr> literals expr boolean_expr binop_expr unaryop_expr array_expr array_access  range_expr
+%type <ident> ident array_type map_type soa_type
+%type <expr> literals expr boolean_expr binop_expr unaryop_expr array_expr array_access array_slice range_expr
 %type <varvec> func_decl_args
-%type <exprvec> call_args array_elemets_expr 
+%type <exprvec> call_args array_elemets_expr case_values
+%type <match_case> match_case
+%type <casevec> match_cases
 %type <block> program stmts block
-%type <stmt> stmt var_decl func_decl conditional return while class_decl array_add_element
+%type <stmt> stmt var_decl func_decl conditional return while class_decl array_add_element match
 %type <token> comparison 
 
 /* Operator precedence for mathematical operators */
+%precedence TELSE
 %left TPLUS TMINUS
 %left TMUL TDIV
 %left TAND TNOT
@@ -132,6 +139,9 @@ stmt : var_decl
      | conditional 
      | return
      | while
+     | match
+     | TBREAK { $$ = new liquid::LoopControl($1, @$); }
+     | TCONTINUE { $$ = new liquid::LoopControl($1, @$); }
      | array_add_element
      | expr { $$ = new liquid::ExpressionStatement($1); }
      ;
@@ -148,14 +158,38 @@ while : TWHILE expr block TELSE block {$$ = new liquid::WhileLoop($2,$3,$5);}
       | TWHILE expr block {$$ = new liquid::WhileLoop($2,$3);}
       ; 
 
+match : TMATCH expr INDENT match_cases UNINDENT { $$ = new liquid::Match($2, $4, nullptr, @$); }
+      | TMATCH expr INDENT match_cases TELSE block UNINDENT { $$ = new liquid::Match($2, $4, $6, @$); }
+      ;
+
+match_cases : match_case { $$ = new liquid::MatchCaseList(); $$->push_back($1); }
+            | match_cases match_case { $1->push_back($2); }
+            ;
+
+match_case : TCASE case_values block { $$ = new liquid::MatchCase($2, $3, @$); }
+           ;
+
+case_values : literals { $$ = new liquid::ExpressionList(); $$->push_back($1); }
+            | case_values ',' literals { $1->push_back($3); }
+            ;
+
 var_decl : ident ident { $$ = new liquid::VariableDeclaration($1, $2, @$); }
          | ident ident '=' expr { $$ = new liquid::VariableDeclaration($1, $2, $4, @$); }
+         | array_type ident { $$ = new liquid::VariableDeclaration($1, $2, @$); }
+         | array_type ident '=' expr { $$ = new liquid::VariableDeclaration($1, $2, $4, @$); }
+         | map_type ident { $$ = new liquid::VariableDeclaration($1, $2, @$); }
+         | map_type ident '=' expr { $$ = new liquid::VariableDeclaration($1, $2, $4, @$); }
+         | soa_type ident { $$ = new liquid::VariableDeclaration($1, $2, @$); }
          | TVAR ident { $$ = new liquid::VariableDeclaration($2, @$); }
          | TVAR ident '=' expr { $$ = new liquid::VariableDeclaration($2, $4, @$); }
+         | TANNOTATION var_decl { $2->addAnnotation($1->substr(1)); delete $1; $$ = $2; }
          ;
 
 func_decl : TDEF ident '(' func_decl_args ')' ':' ident block { $$ = new liquid::FunctionDeclaration($7, $2, $4, $8, @$); }
+          | TDEF ident '(' func_decl_args ')' ':' array_type block { $$ = new liquid::FunctionDeclaration($7, $2, $4, $8, @$); }
+          | TDEF ident '(' func_decl_args ')' ':' map_type block { $$ = new liquid::FunctionDeclaration($7, $2, $4, $8, @$); }
           | TDEF ident '(' func_decl_args ')' block { $$ = new liquid::FunctionDeclaration($2, $4, $6, @$); }
+          | TANNOTATION func_decl { $2->addAnnotation($1->substr(1)); delete $1; $$ = $2; }
           ;
 
 func_decl_args : %empty  { $$ = new liquid::VariableList(); }
@@ -164,6 +198,7 @@ func_decl_args : %empty  { $$ = new liquid::VariableList(); }
           ;
 
 class_decl: TDEF ident block {$$ = new liquid::ClassDeclaration($2, $3); }
+          | TANNOTATION class_decl { $2->addAnnotation($1->substr(1)); delete $1; $$ = $2; }
           ;
 
 return : TRETURN { $$ = new liquid::Return(@$); }
@@ -171,6 +206,7 @@ return : TRETURN { $$ = new liquid::Return(@$); }
        ;
 
 expr : ident '=' expr { $$ = new liquid::Assignment($<ident>1, $3, @$); }
+     | array_access '=' expr { $$ = new liquid::ArrayElementAssignment(static_cast<liquid::ArrayAccess*>($1), $3, @$); }
      | ident '(' call_args ')' { $$ = new liquid::MethodCall($1, $3, @$);  }
      | ident { $<ident>$ = $1; }
      | literals
@@ -178,15 +214,29 @@ expr : ident '=' expr { $$ = new liquid::Assignment($<ident>1, $3, @$); }
      | binop_expr
      | unaryop_expr
      | '(' expr ')' { $$ = $2; }
+     | TIF expr TTHEN expr TELSE expr { $$ = new liquid::Conditional($2, $4, $6, @$); }
      | range_expr
      | array_expr
      | array_access
+     | array_slice
      ;
 
 ident : TIDENTIFIER { $$ = new liquid::Identifier(*$1, @1); delete $1; }
       | TIDENTIFIER '.' TIDENTIFIER { $$ = new liquid::Identifier(*$1,*$3, @$); delete $1; delete $3;}
       ;
 
+/* typed numeric array like int[] or double[] */
+array_type : ident '[' ']' { $$ = new liquid::Identifier($1->getName() + "[]", @$); delete $1; }
+           ;
+
+/* hash map like map<string, int> */
+map_type : TMAP TCLT ident ',' ident TCGT { $$ = new liquid::Identifier("map<" + $3->getName() + "," + $5->getName() + ">", @$); delete $3; delete $5; }
+         ;
+
+/* struct of arrays like soa<point> */
+soa_type : TSOA TCLT ident TCGT { $$ = new liquid::Identifier("soa<" + $3->getName() + ">", @$); delete $3; }
+         ;
+
 literals : TINTEGER { $$ = new liquid::Integer($1); }
          | TDOUBLE { $$ = new liquid::Double($1); }
          | TSTR { $$ = new liquid::String(*$1); delete $1; }
@@ -227,8 +277,13 @@ array_expr : '[' array_elemets_expr ']' {$$ = new liquid::Array($2, @$);}
 array_add_element: ident "<<" expr { $$ = new liquid::ArrayAddElement($1, $3, @$); }
                 ;
                 
-array_access: ident '[' TINTEGER ']' { $$ = new liquid::ArrayAccess($1, $3, @$); }
-           | array_access '[' TINTEGER ']' { $$ = new liquid::ArrayAccess($1, $3, @$); }
+array_access: ident '[' expr ']' { $$ = new liquid::ArrayAccess($1, $3, @$); }
+           | array_access '[' expr ']' { $$ = new liquid::ArrayAccess($1, $3, @$); }
+           ;
+
+array_slice: ident '[' expr ':' expr ']' { $$ = new liquid::ArraySlice($1, $3, $5, @$); }
+           | ident '[' ':' expr ']' { $$ = new liquid::ArraySlice($1, nullptr, $4, @$); }
+           | ident '[' expr ':' ']' { $$ = new liquid::ArraySlice($1, $3, nullptr, @$); }
            ;
 
 range_expr : '[' expr TRANGE expr ']' {$$ = new liquid::Range($2, $4, @$);}
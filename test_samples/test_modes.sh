@@ -0,0 +1,35 @@
+#!/bin/sh
+# Runs scripts in each compile mode: -m tiered and -m latency must print the same as -m throughput.
+# Without script arguments a few samples are run, bench_tiered.liq is hot enough to be optimized by -m tiered.
+#
+# Usage: test_samples/test_modes.sh ./build/liq [script.liq ...]
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 path/to/liq [script.liq ...]" >&2
+    exit 2
+fi
+liq=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+shift
+# The samples import other samples relative to this directory.
+cd "$(dirname "$0")" || exit 2
+if [ $# -eq 0 ]; then
+    set -- test_memo.liq test_tail_call.liq ../bench/bench_tiered.liq
+fi
+
+failed=0
+for script in "$@"; do
+    expected=$("$liq" -q -m throughput "$script" 2>&1)
+    for mode in tiered latency; do
+        actual=$("$liq" -q -m $mode "$script" 2>&1)
+        if [ "$actual" != "$expected" ]; then
+            echo "FAILED: $script -m $mode"
+            printf '%s\n' "$expected" > /tmp/liq_expected.$$
+            printf '%s\n' "$actual" | diff /tmp/liq_expected.$$ -
+            rm -f /tmp/liq_expected.$$
+            failed=1
+        else
+            echo "ok: $script -m $mode"
+        fi
+    done
+done
+exit $failed